@@ -1,4 +1,13 @@
-static const char *font = "Liberation Sans:size=12";
+/* The fonts, colors, paddings, border width and items below can also be
+ * changed while tibaji runs, in $XDG_CONFIG_HOME/tibaji/config (or
+ * ~/.config/tibaji/config). See the README. */
+
+/* The first font is the main one. The others are tried, in order, for
+ * characters it lacks, and fontconfig is asked when none has them. */
+static const char *fonts[] = {
+	"Liberation Sans:size=12",
+	/* "Noto Sans CJK JP:size=12", */
+};
 
 #define BORDER_WIDTH 3
 #define BAR_PADDING 3
@@ -10,20 +19,90 @@ static const char *font = "Liberation Sans:size=12";
 #define BAR_BACKGROUND 0xffffff
 #define BAR_FOREGROUND 0X000000
 
+/* Set to 1 to move and resize floating windows as an outline, giving
+ * the window its new geometry only when done. Smoother with windows that
+ * are slow to redraw. */
+#define OUTLINE_MOVE 0
+
 /* Maximum number of characters of the window name drawn on the bar.
  * Should allow to the buttons after it (i.e., should be < 1/5 of the screen. */
 #define MAX_WNAME_CHAR 30
 
+/* Set to 1 to mark the windows of the workspaces not shown as iconic, and
+ * to stop (SIGSTOP) the programs below while their workspace isn't shown.
+ * They are stopped FREEZE_DELAY milliseconds after leaving it, and resumed
+ * as soon as it's shown again. Matched against the WM_CLASS class and
+ * instance. */
+#define FREEZE_INACTIVE 0
+#define FREEZE_DELAY 3000
+static const char *freeze[] = { "chromium", "Chromium", "firefox" };
+
+/* Set to 1 to show how much CPU and memory the program of the current
+ * window uses, next to its name, and to list the hidden windows using
+ * more first. Every USAGE_INTERVAL milliseconds, USAGE_BATCH windows are
+ * sampled besides the current one. */
+#define SHOW_USAGE 0
+#define USAGE_INTERVAL 2000
+#define USAGE_BATCH 8
+
 #define MODMASK (Mod4Mask)
 #define FULLSCREEN_KEY XK_f
 #define RESIZE_KEY XK_r
 #define REDRAW_KEY XK_a
 #define DETACH_KEY XK_d
+/* MODMASK + the nth key goes straight to the nth workspace. */
+static const KeySym workspace_keys[] = {
+	XK_1, XK_2, XK_3, XK_4, XK_5, XK_6, XK_7, XK_8, XK_9,
+};
+
+/* Title, status and redraw events wait for input and window changes to
+ * be handled first, but no longer than this (in milliseconds). */
+#define DEFER_DELAY 50
+
+/* Workspace switches closer than this (in milliseconds) to the last one
+ * are merged, so clicking or scrolling through workspaces only shows the
+ * last one. A switch on its own is done at once. */
+#define SWITCH_DELAY 150
+
+/* Status modules, drawn at the end of the bar after the root window name,
+ * which can still be set by programs like slstatus. Each runs every
+ * interval milliseconds and only its own part of the bar is drawn again,
+ * when what it shows changes. The clock takes a strftime(3) format, the
+ * battery its name in /sys/class/power_supply, and the volume the ALSA
+ * control device whose "Master" control is shown. The volume has no
+ * interval, it's drawn again when the device reports a change, or read
+ * every MODULE_POLL milliseconds when it can't. */
+#define MODULE_POLL 5000
+static const Module modules[] = {
+	/* function      argument              interval */
+	/* { mod_cpu,       NULL,                 2000 }, */
+	/* { mod_mem,       NULL,                 5000 }, */
+	/* { mod_volume,    "/dev/snd/controlC0", 0 }, */
+	/* { mod_battery,   "BAT0",               30000 }, */
+	/* { mod_clock,     "%a %d %b %H:%M",     1000 }, */
+};
+
+/* Rules for new windows. NULL matches anything, and the title matches if
+ * it contains the given text. Workspaces are counted from 1, and 0 means
+ * the current one. When several rules match, the last one wins.
+ * Transient windows and windows that can't be resized always float. */
+static const Rule rules[] = {
+	/* class      instance  title  float  hidden  workspace */
+	/* { "Gimp",     NULL,     NULL,  1,     0,      0 }, */
+};
+
+/* Part of the screen's width given to the master column, and how many
+ * windows it has, in new workspaces. Dragging the border between the
+ * master and the stack changes the first, and scrolling over it the
+ * second. While dragging, windows are laid out at most once every
+ * LAYOUT_DELAY milliseconds. */
+#define MFACT 0.5
+#define NMASTER 1
+#define LAYOUT_DELAY 30
 
 /* Space in pixels between buttons. */
 #define MENU_PADDING 5
 
-static const char *menu[] = { "dmenu_run", NULL };
 static const char *acme[] = { "acme", NULL };
 static const char *term[] = { "alacritty", NULL };
 static const char *term9[] = { "9term", NULL };
@@ -34,16 +113,20 @@ static const char *volm[] = { "pamixer", "-d", "5", NULL };
 static const char *brip[] = { "brightnessctl", "set", "+5%", NULL };
 static const char *brim[] = { "brightnessctl", "set", "5%-", NULL };
 
-/* The last two does not matter. */
+/* The fourth field is how many instances to keep started and parked
+ * off-screen, so clicking the item shows one at once. The last two does
+ * not matter. An item with no command opens the launcher, which shows
+ * LAUNCHER_LINES programs starting with what's typed. */
+#define LAUNCHER_LINES 10
 static MenuItem items[] = {
-	{ "menu", menu, 4, 0, 0 },
-	{ "acme", acme, 4, 0, 0 },
-	{ "term", term, 4, 0, 0 },
-	{ "9term", term9, 5, 0, 0 },
-	{ "web", brow, 3, 0, 0 },
-	{ "fm", fm, 2, 0, 0 },
-	{ "v+", volp, 2, 0, 0 },
-	{ "v-", volm, 2, 0, 0 },
-	{ "b+", brip, 2, 0, 0 },
-	{ "b-", brim, 2, 0, 0 },
+	{ "menu", NULL, 4, 0, 0, 0 },
+	{ "acme", acme, 4, 0, 0, 0 },
+	{ "term", term, 4, 0, 0, 0 },
+	{ "9term", term9, 5, 0, 0, 0 },
+	{ "web", brow, 3, 0, 0, 0 },
+	{ "fm", fm, 2, 0, 0, 0 },
+	{ "v+", volp, 2, 0, 0, 0 },
+	{ "v-", volm, 2, 0, 0, 0 },
+	{ "b+", brip, 2, 0, 0, 0 },
+	{ "b-", brim, 2, 0, 0, 0 },
 };
@@ -0,0 +1,44 @@
+#!/bin/sh
+# Has tests/driver do each operation under tests/tibaji with 1, 4 and 16
+# windows open, and checks the requests and round trips each took against
+# tests/budgets. Fails if any is over its budget, or has none. With -u the
+# budgets are written from what's measured instead.
+
+cd "$(dirname "$0")" || exit 1
+. ./session.sh
+
+./driver budget >"$tmp/measured" || exit 1
+
+if [ "$1" = -u ]; then
+	{ grep '^#' budgets; cat "$tmp/measured"; } >"$tmp/budgets"
+	mv "$tmp/budgets" budgets
+	exit 0
+fi
+
+awk '
+FNR == NR {
+	if ($1 !~ /^#/ && NF == 4) {
+		req[$1 " " $2] = $3
+		trips[$1 " " $2] = $4
+		n++
+	}
+	next
+}
+FNR == 1 && n == 0 {
+	print "tests/budgets has no budgets yet, tests/budget.sh -u writes them"
+}
+{
+	k = $1 " " $2
+	if (!(k in req)) {
+		printf "%-16s %2d  no budget\n", $1, $2
+		bad = 1
+		next
+	}
+	over = $3 > req[k] || $4 > trips[k]
+	bad = bad || over
+	printf "%-16s %2d  %4d/%-4d requests  %d/%d round trips%s\n", $1, $2,
+		$3, req[k], $4, trips[k], over ? "  OVER" : ""
+}
+END {
+	exit bad
+}' budgets "$tmp/measured"
@@ -0,0 +1,319 @@
+/* Drives a tibaji built with TESTS on a throwaway display, for make soak
+ * and make check. It opens its own windows and asks tibaji for the clicks
+ * a user would make through client messages to the root window. */
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/Xatom.h>
+#include <X11/extensions/XRes.h>
+#include <math.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* The same as in tibaji.c. */
+enum { TestMark, TestFocus, TestButton, TestUnhide, TestWorkspace };
+enum { TestHide, TestZoom, TestFloat };
+
+/* Samples taken over a soak, and how many of the first are left out as
+ * the warm-up, while the caches of tibaji fill. */
+#define SOAK_SAMPLES 200
+#define SOAK_WARMUP 20
+
+#define LENGTH(X) (sizeof X / sizeof X[0])
+
+/* How many windows are open while the operations are measured. */
+static const int budget_windows[] = { 1, 4, 16 };
+
+static Display *dpy;
+static Window root;
+static Window self;
+static Atom test;
+static int answered;
+
+void send_op(long op, long arg)
+{
+	XEvent ev;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.xclient.type = ClientMessage;
+	ev.xclient.window = root;
+	ev.xclient.message_type = test;
+	ev.xclient.format = 32;
+	ev.xclient.data.l[0] = op;
+	ev.xclient.data.l[1] = arg;
+	XSendEvent(dpy, root, False, SubstructureRedirectMask, &ev);
+	XFlush(dpy);
+}
+
+/* Reads the requests and round trips tibaji wrote for the mark. */
+void read_counts(unsigned long *counts)
+{
+	Atom type;
+	int format;
+	unsigned long n, left;
+	unsigned char *data = NULL;
+
+	counts[0] = counts[1] = 0;
+	if (XGetWindowProperty(dpy, self, test, 0, 2, False, XA_CARDINAL,
+			&type, &format, &n, &left, &data) == Success && n == 2) {
+		counts[0] = ((long*) data)[0];
+		counts[1] = ((long*) data)[1];
+	}
+	if (data != NULL)
+		XFree(data);
+}
+
+/* Waits until tibaji has done everything asked before, switches and
+ * redraws it holds back included, and gets what it took if counts isn't
+ * NULL. Until tibaji first answers the mark is sent again every second, as
+ * it may not be running yet; after that once is enough. */
+void mark(unsigned long *counts)
+{
+	struct pollfd pfd;
+	XEvent ev;
+	int tries;
+
+	pfd.fd = ConnectionNumber(dpy);
+	pfd.events = POLLIN;
+	for (tries = 0; tries < 10; tries++) {
+		if (tries == 0 || !answered)
+			send_op(TestMark, self);
+		do {
+			while (XPending(dpy)) {
+				XNextEvent(dpy, &ev);
+				if (ev.type == PropertyNotify && ev.xproperty.window == self
+						&& ev.xproperty.atom == test && ev.xproperty.state == PropertyNewValue) {
+					if (counts != NULL)
+						read_counts(counts);
+					answered = 1;
+					return;
+				}
+			}
+		} while (poll(&pfd, 1, 1000) > 0);
+	}
+	fprintf(stderr, "driver: tibaji doesn't answer\n");
+	exit(1);
+}
+
+Window open_window(void)
+{
+	XEvent ev;
+	Window w = XCreateSimpleWindow(dpy, root, 0, 0, 200, 100, 0, 0, 0);
+
+	XSelectInput(dpy, w, StructureNotifyMask);
+	XMapWindow(dpy, w);
+	do
+		XWindowEvent(dpy, w, StructureNotifyMask, &ev);
+	while (ev.type != MapNotify);
+	return w;
+}
+
+/* Resident memory of the program, in kilobytes. */
+long rss(pid_t pid)
+{
+	char path[64];
+	long size, pages = -1;
+	FILE *f;
+
+	snprintf(path, sizeof(path), "/proc/%d/statm", (int) pid);
+	if ((f = fopen(path, "r")) == NULL)
+		return -1;
+	if (fscanf(f, "%ld %ld", &size, &pages) != 2)
+		pages = -1;
+	fclose(f);
+	return pages < 0 ? -1 : pages * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+/* Windows, pixmaps, pictures, glyph sets and the rest the X server keeps
+ * for the client of the program. */
+long resources(pid_t pid)
+{
+	XResClientIdSpec spec = { None, XRES_CLIENT_ID_PID_MASK };
+	XResClientIdValue *ids;
+	XResType *types;
+	long n, i, total = -1;
+	int n_types, j;
+
+	if (XResQueryClientIds(dpy, 1, &spec, &n, &ids) != Success)
+		return -1;
+	for (i = 0; i < n && total < 0; i++) {
+		if (XResGetClientPid(&ids[i]) != pid)
+			continue;
+		if (!XResQueryClientResources(dpy, ids[i].spec.client, &n_types, &types))
+			continue;
+		for (total = 0, j = 0; j < n_types; j++)
+			total += types[j].count;
+		XFree(types);
+	}
+	XResClientIdsDestroy(n, ids);
+	return total;
+}
+
+/* Opens a window, retitles it and the status, hides and unhides it,
+ * floats it and back, and closes it. */
+void soak_cycle(int i)
+{
+	char name[32];
+	Window w = open_window();
+
+	snprintf(name, sizeof(name), "soak %d", i);
+	XStoreName(dpy, w, name);
+	XStoreName(dpy, root, name);
+	send_op(TestButton, TestHide);
+	send_op(TestUnhide, 0);
+	send_op(TestButton, TestFloat);
+	send_op(TestButton, TestFloat);
+	send_op(TestFocus, w);
+	XDestroyWindow(dpy, w);
+	mark(NULL);
+}
+
+/* Fits a line through the samples by least squares and returns its
+ * slope, leaving in *err its standard error. */
+double slope(const double *x, const double *y, int n, double *err)
+{
+	double mx = 0, my = 0, sxx = 0, sxy = 0, ss = 0, b, d;
+	int i;
+
+	for (i = 0; i < n; i++) {
+		mx += x[i] / n;
+		my += y[i] / n;
+	}
+	for (i = 0; i < n; i++) {
+		sxx += (x[i] - mx) * (x[i] - mx);
+		sxy += (x[i] - mx) * (y[i] - my);
+	}
+	b = sxy / sxx;
+	for (i = 0; i < n; i++) {
+		d = y[i] - my - b * (x[i] - mx);
+		ss += d * d;
+	}
+	*err = sqrt(ss / (n - 2) / sxx);
+	return b;
+}
+
+/* Samples tibaji SOAK_SAMPLES times over the cycles, each after a mark so
+ * it has nothing left to do, and fits a line through the samples after
+ * the warm-up. Fails if either its memory or its X resources grow with
+ * the cycles by more than three standard errors of the slope, which a
+ * leak of a byte a cycle does over the default cycles. */
+int soak(pid_t pid, int cycles)
+{
+	static double x[SOAK_SAMPLES], r[SOAK_SAMPLES], n[SOAK_SAMPLES];
+	int every = cycles / SOAK_SAMPLES > 0 ? cycles / SOAK_SAMPLES : 1;
+	int i, k = 0, bad = 0;
+	double b, err;
+	long rk, nk;
+
+	printf("cycle rss_kb resources\n");
+	for (i = 1; i <= cycles; i++) {
+		soak_cycle(i);
+		if (i % every != 0 || i / every > SOAK_SAMPLES)
+			continue;
+		if ((rk = rss(pid)) < 0 || (nk = resources(pid)) < 0) {
+			fprintf(stderr, "driver: can't sample tibaji\n");
+			return 1;
+		}
+		printf("%d %ld %ld\n", i, rk, nk);
+		fflush(stdout);
+		if (i / every > SOAK_WARMUP) {
+			x[k] = i;
+			r[k] = rk * 1024.0;
+			n[k++] = nk;
+		}
+	}
+	if (k < 3) {
+		fprintf(stderr, "driver: too few cycles to soak\n");
+		return 1;
+	}
+
+	b = slope(x, r, k, &err);
+	fprintf(stderr, "driver: memory grows %.3f bytes a cycle, give or take %.3f\n", b, err);
+	bad |= b - 3 * err > 0;
+	b = slope(x, n, k, &err);
+	fprintf(stderr, "driver: resources grow %.6f a cycle, give or take %.6f\n", b, err);
+	bad |= b - 3 * err > 0;
+	return bad;
+}
+
+/* Prints what the operation took since the last mark. */
+void measure(const char *op, int n)
+{
+	unsigned long counts[2];
+
+	mark(counts);
+	printf("%s %d %lu %lu\n", op, n, counts[0], counts[1]);
+	fflush(stdout);
+}
+
+/* Prints the requests and round trips each operation takes, with the
+ * windows of budget_windows open. The last one opened is the current
+ * one, and the first one is focused, zoomed, floated, hidden and shown
+ * again. */
+int budget(void)
+{
+	Window w[16], extra;
+	unsigned int k;
+	int i, n;
+
+	for (k = 0; k < LENGTH(budget_windows); k++) {
+		n = budget_windows[k];
+		for (i = 0; i < n; i++) {
+			w[i] = open_window();
+			XStoreName(dpy, w[i], "window");
+		}
+		mark(NULL);
+
+		XStoreName(dpy, w[n - 1], "budget");
+		measure("title", n);
+		send_op(TestFocus, w[0]);
+		measure("focus", n);
+		send_op(TestButton, TestZoom);
+		measure("zoom", n);
+		send_op(TestButton, TestFloat);
+		measure("float", n);
+		send_op(TestButton, TestFloat);
+		measure("unfloat", n);
+		send_op(TestButton, TestHide);
+		measure("hide", n);
+		send_op(TestUnhide, 0);
+		measure("unhide", n);
+		send_op(TestWorkspace, 1);
+		measure("workspace", n);
+		send_op(TestWorkspace, 0);
+		measure("workspace-back", n);
+		extra = open_window();
+		measure("map", n);
+		XDestroyWindow(dpy, extra);
+		measure("destroy", n);
+
+		for (i = 0; i < n; i++)
+			XDestroyWindow(dpy, w[i]);
+		mark(NULL);
+	}
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	if (!(argc == 4 && !strcmp(argv[1], "soak")) && !(argc == 2 && !strcmp(argv[1], "budget"))) {
+		fprintf(stderr, "usage: driver soak pid cycles | driver budget\n");
+		return 2;
+	}
+	if (!(dpy = XOpenDisplay(NULL))) {
+		fprintf(stderr, "driver: can't open the display\n");
+		return 1;
+	}
+	root = DefaultRootWindow(dpy);
+	test = XInternAtom(dpy, "_TIBAJI_TEST", False);
+	/* Never mapped, so it isn't managed. */
+	self = XCreateSimpleWindow(dpy, root, 0, 0, 1, 1, 0, 0, 0);
+	XSelectInput(dpy, self, PropertyChangeMask);
+	mark(NULL);
+
+	if (argc == 2)
+		return budget();
+	return soak(atoi(argv[2]), atoi(argv[3]));
+}
@@ -0,0 +1,24 @@
+# Sourced by the tests. Starts Xvfb on a free display and tests/tibaji on
+# it, with a config of its own that parks no programs, and leaves the pid
+# of tibaji in $wm. Both are killed when the test exits.
+
+tmp=$(mktemp -d) || exit 1
+trap 'kill $wm $xvfb 2>/dev/null; rm -rf "$tmp"' EXIT
+trap 'exit 1' INT TERM
+
+Xvfb -displayfd 3 -screen 0 1280x800x24 -nolisten tcp 3>"$tmp/display" 2>"$tmp/xvfb.log" &
+xvfb=$!
+while [ ! -s "$tmp/display" ]; do
+	if ! kill -0 $xvfb 2>/dev/null; then
+		cat "$tmp/xvfb.log" >&2
+		exit 1
+	fi
+	sleep 1
+done
+DISPLAY=:$(cat "$tmp/display")
+export DISPLAY
+
+mkdir "$tmp/tibaji"
+echo "item menu 0" >"$tmp/tibaji/config"
+XDG_CONFIG_HOME=$tmp ./tibaji &
+wm=$!
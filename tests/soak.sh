@@ -0,0 +1,10 @@
+#!/bin/sh
+# Has tests/driver open, retitle, hide, unhide, float and close windows
+# under tests/tibaji CYCLES times (200000 by default), sampling its
+# resident memory and X resources. Fails if they grow with the cycles after
+# the warm-up.
+
+cd "$(dirname "$0")" || exit 1
+. ./session.sh
+
+./driver soak $wm "${CYCLES:-200000}"
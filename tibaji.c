@@ -1,4 +1,7 @@
 #include <X11/Xlib.h>
+#include <X11/Xlib-xcb.h>
+#include <xcb/xcb.h>
+#include <xcb/xcbext.h>
 #include <X11/Xft/Xft.h>
 #include <X11/Xutil.h>
 #include <X11/X.h>
@@ -7,8 +10,42 @@
 #include <sys/wait.h>
 #include <signal.h>
 #include <stdlib.h>
+#include <string.h>
+#include <X11/Xatom.h>
+#include <poll.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+#include <dirent.h>
+#include <sys/ioctl.h>
+#include <sound/asound.h>
+#include <locale.h>
+#include <errno.h>
+#ifdef TESTS
+#include <dlfcn.h>
+#endif
 
 #define LENGTH(X) (sizeof X / sizeof X[0])
+#define TITLE_BUCKETS 64
+/* Window titles taken from the arena at a time. */
+#define TITLE_SLOTS 64
+#define MAX_FONTS 16
+#define GLYPH_CACHE 512
+#define MAX_POOL 32
+#define RULE_BUCKETS 32
+#define MAX_REPLIES 8
+/* Bytes of the root window name fetched for the status. */
+#define MAX_STATUS 1024
+#define MAX_MODULES 16
+#define MODULE_TEXT 64
+/* Cosmetic events held until the queue is empty. */
+#define MAX_DEFERRED 64
+/* Entries kept by the flight recorder, a power of two. */
+#define MAX_RECORDS 4096
+/* Processes stopped, counting the ones the programs started. */
+#define MAX_STOPPED 512
+#define MAX_HOST 256
 
 /*
  * Copyright (C) 2024  Gabriel de Brito
@@ -31,10 +68,100 @@
  * THE SOFTWARE.
  */
 
+/* A piece of text drawn with a single font. */
+typedef struct {
+	int font;
+	int off;
+	int len;
+	int x;
+} TextRun;
+
+/* Window titles are interned: clients with the same (truncated) name share
+ * one Title, which also caches how it's drawn on the bar. Its runs come
+ * right after the text, in the same block. */
+typedef struct Title {
+	unsigned int refs;
+	unsigned int hash;
+	int len;
+	int x;
+	int width;
+	int n_runs;
+	/* Taken from the arena of window titles. */
+	short int slot;
+	TextRun *runs;
+	struct Title *next;
+	char str[];
+} Title;
+
+typedef struct {
+	FcChar32 cp;
+	int font;
+} GlyphCache;
+
+typedef struct {
+	const char *label;
+	const char **command;
+	unsigned int size;
+	unsigned int pool;
+	unsigned int x;
+	unsigned int w;
+} MenuItem;
+
+/* What can be changed in the config file while running. It starts as set
+ * in config.h. */
+typedef struct {
+	const char *font;
+	int border_width;
+	int bar_padding;
+	int menu_padding;
+	unsigned long border_color;
+	unsigned long border_focus;
+	unsigned long bar_background;
+	unsigned long bar_foreground;
+	MenuItem *items;
+	unsigned int n_items;
+	/* The text of the file, which the strings above point into, and the
+	 * commands of its items. */
+	char *text;
+	const char **args;
+} Config;
+
+/* What a program uses, shared by its windows, which may be many for a
+ * browser or a terminal server. */
+typedef struct Usage {
+	pid_t pid;
+	unsigned int refs;
+	/* /proc/pid/stat and statm, kept open to sample it, or -1. */
+	int stat_fd;
+	int statm_fd;
+	/* CPU time in clock ticks when last sampled, and when that was. */
+	unsigned long ticks;
+	long sampled;
+	/* CPU use in percent since the sample before, and resident memory
+	 * in KiB. */
+	unsigned int cpu;
+	unsigned long rss;
+	struct Usage *next;
+} Usage;
+
 typedef struct Client {
-	unsigned char *name;
+	Title *name;
 	Window id;
+	pid_t pid;
+	/* Last geometry given to the window, without the border. */
+	int x;
+	int y;
+	int w;
+	int h;
+	/* Item it was started for, while parked, and where the rules put it
+	 * when it's shown. */
+	MenuItem *pool;
+	short int rule_hidden;
+	unsigned int rule_workspace;
+	short int freeze;
 	short int is_float;
+	/* What its program uses, or NULL. */
+	Usage *usage;
 	struct Client *next;
 	struct Client *prev;
 } Client;
@@ -45,33 +172,190 @@ typedef struct Workspace {
 	Client *clients;
 	Client *floats;
 	Client *current;
-	struct Workspace *next;
-	struct Workspace *prev;
+	long freeze_at;
+	/* Part of the width given to the master column, and how many
+	 * clients share it. */
+	float mfact;
+	unsigned int n_master;
 } Workspace;
 
 typedef struct Cursors {
 	Cursor left_ptr;
 	Cursor sizing;
+	Cursor split;
 } Cursors;
 
 typedef struct {
-	const char *label;
-	const char **command;
-	unsigned int size;
-	unsigned int x;
-	unsigned int w;
-} MenuItem;
+	pid_t pid;
+	MenuItem *item;
+} Spawn;
+
+typedef struct {
+	const char *class;
+	const char *instance;
+	const char *title;
+	short int is_float;
+	short int hidden;
+	unsigned int workspace;
+} Rule;
+
+enum { TimerFreeze, TimerSwitch, TimerUsage, TimerLayout, TimerDeferred, TimerModules, TimerLast };
+
+enum { RecEvent, RecTimer, RecLayout, RecFocus, RecError };
+
+/* Something the window manager did, kept by the flight recorder. Times
+ * are in nanoseconds. code is the event type, the timer, the number of
+ * tiled clients or the error code, and arg the request code and minor
+ * code of an error. */
+typedef struct {
+	long t;
+	long dur;
+	unsigned long id;
+	short int kind;
+	short int code;
+	int arg;
+} Record;
+
+/* What the pointer and the keyboard are doing. */
+enum { ModeNormal, ModeMove, ModeMenu, ModeFullscreen, ModeSplit, ModeLauncher };
+
+struct Wm;
+
+/* What a status module keeps between runs, and where it's drawn. */
+typedef struct {
+	int fd;
+	int fd2;
+	/* A file the main loop waits on along with the X connection, running
+	 * the module when it's readable, or -1. */
+	int watch;
+	unsigned long long prev[2];
+	long next;
+	char text[MODULE_TEXT];
+	int x;
+	int w;
+} ModuleState;
 
 typedef struct {
+	void (*fn)(struct Wm *wm, ModuleState *m, const char *arg, char *buf);
+	const char *arg;
+	/* Milliseconds between runs. With 0 it only runs again when its
+	 * watch file is readable. */
+	long interval;
+} Module;
+
+/* Queries sent with XCB and not answered yet. The event loop goes on
+ * while they are in flight, and done() is called once all the replies of
+ * an entry have arrived. */
+typedef struct Pending {
+	Window win;
+	short int scanned;
+	/* Asked again while in flight. */
+	short int again;
+	int n;
+	int got;
+	unsigned int seq[MAX_REPLIES];
+	void *replies[MAX_REPLIES];
+	void (*done)(struct Wm *wm, struct Pending *p);
+	struct Pending *next;
+} Pending;
+
+/* What's known about a window when it's about to be managed. */
+typedef struct {
+	int x;
+	int y;
+	int w;
+	int h;
+	pid_t pid;
+	/* WM_CLIENT_MACHINE is this one, so pid is one of its processes. */
+	short int local;
+	XClassHint hint;
+	short int is_float;
+	char *name;
+	int name_len;
+} WindowInfo;
+
+typedef struct Wm {
 	unsigned int n_works;
 	unsigned int n_cur;
+	unsigned int works_size;
+	/* The current workspace, works[n_cur]. */
 	Workspace *workspaces;
+	Workspace **works;
 	unsigned int n_hidden;
 	Client *hidden;
+	Client *parked;
+	Spawn pool_pending[MAX_POOL];
+	unsigned int n_pending;
+	Atom net_wm_pid;
+	Atom wm_state;
+	char host[MAX_HOST];
+#ifdef TESTS
+	/* Client messages the driver in tests/ sends to the root window. */
+	Atom test;
+#endif
+	/* Rules by WM_CLASS class, chained by index. The last bucket has the
+	 * ones that match any class. */
+	int rule_heads[RULE_BUCKETS + 1];
+	int *rule_next;
+	/* Deadlines in milliseconds, 0 when not armed. */
+	long timers[TimerLast];
+	Config conf;
+	/* What the programs with windows use, one per program. */
+	Usage *usages;
+	/* The next client whose usage is sampled. The tiled and floating
+	 * clients of each workspace and then the hidden ones are gone through
+	 * in turn, and usage_list is the one after the list it's in. When it's
+	 * NULL, sampling starts from the first client of usage_list. */
+	Client *usage_at;
+	unsigned int usage_list;
+	long clock_ticks;
+	long page_kb;
+	char bar_usage[32];
+	/* Status modules, drawn at the end of the bar, after the root window
+	 * name. mods_w is how much of the bar they take. */
+	ModuleState mods[MAX_MODULES];
+	int n_mods;
+	int mods_w;
+	short int mods_dirty;
+	/* The config file is watched through its directory, as editors
+	 * often replace the file instead of writing to it. Until the
+	 * directory exists, the closest one that does is watched instead:
+	 * conf_watch_len is how much of conf_path is watched, and
+	 * conf_dir_len how much is the config directory. */
+	char *conf_path;
+	const char *conf_name;
+	int inotify;
+	int conf_wd;
+	int conf_dir_len;
+	int conf_watch_len;
+	/* Programs in the PATH, sorted, for the launcher. The index is built
+	 * the first time it's opened, and then kept up to date by watching
+	 * the directories. */
+	char **progs;
+	unsigned int n_progs;
+	unsigned int progs_size;
+	short int progs_built;
+	int *path_fds;
+	int *path_wds;
+	unsigned int n_path;
+	/* What's typed in the launcher, and the programs starting with it,
+	 * from progs[l_lo] to progs[l_hi - 1]. */
+	char l_text[256];
+	unsigned int l_len;
+	unsigned int l_lo;
+	unsigned int l_hi;
+	/* Reads what's typed in the launcher as UTF-8. Without an input
+	 * method only ASCII is taken. */
+	XIM xim;
+	XIC xic;
 	unsigned int bar_height;
 	int bar_y;
 	Window bar;
 	Window cli_win;
+	/* Takes the clicks on the border between the master and the stack.
+	 * handle_x is where that border is, or -1 if it isn't shown. */
+	Window handle;
+	int handle_x;
 	int screen;
 	int sw;
 	int sh;
@@ -81,9 +365,31 @@ typedef struct {
 	KeyCode akey;
 	KeyCode rkey;
 	Display *dpy;
+	xcb_connection_t *xcb;
+	Pending *pending;
+	Pending **pending_tail;
+	/* PropertyNotify and Expose events left for when there's nothing
+	 * else to do, one per window and property or per window. */
+	XEvent deferred[MAX_DEFERRED];
+	unsigned int n_deferred;
 	Cursors cursors;
-	unsigned char *status;
+	Title *titles[TITLE_BUCKETS];
+	/* Slots of the title arena not in use. */
+	Title *free_titles;
+	Title *status;
 	XftFont *xftfont;
+	XftFont *fonts[MAX_FONTS];
+	int n_fonts;
+	GlyphCache glyphs[GLYPH_CACHE];
+	XftDraw *bar_draw;
+	Pixmap bar_buf;
+	GC bar_gc;
+	Title *bar_name;
+	Title *bar_status;
+	char bar_works[128];
+	short int bar_dirty;
+	int statusx;
+	XftDraw *cli_draw;
 	XRenderColor xrcolor;
 	XftColor xftcolor;
 	int hidex;
@@ -98,8 +404,30 @@ typedef struct {
 	int movew;
 	int wx;
 	int ww;
+	int wcell;
+	unsigned int wfirst;
+	/* Workspace to switch to when the clicks stop, or -1, and when the
+	 * last switch was done. */
+	int switch_to;
+	long switched_at;
+	int mode;
+	/* The client being moved or shown fullscreen, with the geometry
+	 * it's being moved to or had before going fullscreen. */
+	Client *grabbed;
+	int gx;
+	int gy;
+	int gw;
+	int gh;
+	short int resizing;
+	GC outline;
 } Wm;
 
+void mod_clock(Wm *wm, ModuleState *m, const char *arg, char *buf);
+void mod_cpu(Wm *wm, ModuleState *m, const char *arg, char *buf);
+void mod_mem(Wm *wm, ModuleState *m, const char *arg, char *buf);
+void mod_battery(Wm *wm, ModuleState *m, const char *arg, char *buf);
+void mod_volume(Wm *wm, ModuleState *m, const char *arg, char *buf);
+
 #include "config.h"
 
 static const char *wincmds[] = {
@@ -110,16 +438,138 @@ static const char *wincmds[] = {
 	"Move",
 };
 
-void handle_event(Wm *wm, XEvent *ev);
+void leave_mode(Wm *wm);
+void draw_launcher(Wm *wm);
+
+/* The last MAX_RECORDS things done, written out when tibaji crashes or
+ * gets SIGUSR1. They are outside the Wm so the signal handlers can reach
+ * them. Recording only stores a few words, so it's always on. */
+static Record records[MAX_RECORDS];
+static unsigned long n_records;
+
+/* Processes stopped while the workspace of their program isn't shown, and
+ * the program each belongs to. Also outside the Wm, so they are resumed
+ * however tibaji goes away. */
+static pid_t stopped[MAX_STOPPED];
+static pid_t stopped_by[MAX_STOPPED];
+static unsigned int n_stopped;
+
+long record_time(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+/* Records something that started at start, as returned by record_time(),
+ * and ends now. With start 0 it takes no time. */
+void record(short int kind, short int code, int arg, unsigned long id, long start)
+{
+	Record *r = &records[n_records++ % MAX_RECORDS];
+	long now = record_time();
+
+	r->t = start != 0 ? start : now;
+	r->dur = now - r->t;
+	r->kind = kind;
+	r->code = code;
+	r->arg = arg;
+	r->id = id;
+}
+
+/* Writes n in base at the end of buf, returning where it starts. No
+ * stdio, as it's called from signal handlers. */
+char *format_num(char *end, unsigned long n, int base)
+{
+	do {
+		*--end = "0123456789abcdef"[n % base];
+		n /= base;
+	} while (n > 0);
+	return end;
+}
+
+void dump_records(void)
+{
+	static const char *kinds[] = {
+		[RecEvent] = "event",
+		[RecTimer] = "timer",
+		[RecLayout] = "layout",
+		[RecFocus] = "focus",
+		[RecError] = "error",
+	};
+	char line[128];
+	char *p, *end = line + sizeof(line);
+	unsigned long i = n_records > MAX_RECORDS ? n_records - MAX_RECORDS : 0;
+	Record *r;
+
+	/* Each line is: time and duration in microseconds, kind, code,
+	 * argument and window. */
+	for (; i < n_records; i++) {
+		r = &records[i % MAX_RECORDS];
+		p = end;
+		*--p = '\n';
+		p = format_num(p, r->id, 16);
+		*--p = 'x';
+		*--p = '0';
+		*--p = ' ';
+		p = format_num(p, r->arg, 10);
+		*--p = ' ';
+		p = format_num(p, r->code, 10);
+		*--p = ' ';
+		p -= strlen(kinds[r->kind]);
+		memcpy(p, kinds[r->kind], strlen(kinds[r->kind]));
+		*--p = ' ';
+		p = format_num(p, r->dur / 1000, 10);
+		*--p = ' ';
+		p = format_num(p, r->t / 1000, 10);
+		write(STDERR_FILENO, p, end - p);
+	}
+}
+
+void resume_programs(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < n_stopped; i++)
+		kill(stopped[i], SIGCONT);
+	n_stopped = 0;
+}
+
+void dump_handler(int sig)
+{
+	write(STDERR_FILENO, "tibaji: flight recorder\n", 24);
+	dump_records();
+	/* The crash goes on as it would. */
+	if (sig != SIGUSR1) {
+		resume_programs();
+		raise(sig);
+	}
+}
+
+/* Nothing is left stopped when tibaji is killed or loses the display. */
+void quit_handler(int sig)
+{
+	resume_programs();
+	raise(sig);
+}
+
+int io_error_handler(Display *dpy)
+{
+	resume_programs();
+	return 0;
+}
 
-int error_handler(Display *dpy, XErrorEvent *_e)
+int error_handler(Display *dpy, XErrorEvent *e)
 {
+	record(RecError, e->error_code, e->request_code << 8 | e->minor_code, e->resourceid, 0);
 	return 0;
 }
 
 void child_handler(int _a)
 {
-	wait(NULL);
+	/* SIGCHLD is not queued, so a single signal may stand for several
+	 * children. */
+	while (waitpid(-1, NULL, WNOHANG) > 0);
 }
 
 typedef struct {
@@ -133,12 +583,14 @@ FindResult find_window(Wm *wm, Window win)
 	Workspace *w;
 	Client *c;
 	FindResult r;
+	unsigned int i;
 
 	r.c = NULL;
 	r.w = NULL;
 	r.is_float = 0;
 
-	for (w = wm->workspaces; w != NULL; w = w->next) {
+	for (i = 0; i < wm->n_works; i++) {
+		w = wm->works[i];
 		for (c = w->clients; c != NULL; c = c->next) {
 			if (c->id == win) {
 				r.c = c;
@@ -163,6 +615,13 @@ FindResult find_window(Wm *wm, Window win)
 		}
 	}
 
+	for (c = wm->parked; c != NULL; c = c->next) {
+		if (c->id == win) {
+			r.c = c;
+			return r;
+		}
+	}
+
 	return r;
 }
 
@@ -171,298 +630,1522 @@ short int managed(Wm *wm, Window win)
 	return (find_window(wm, win).c != NULL);
 }
 
-void update_status(Wm *wm)
+unsigned int hash_str(const char *str, int len)
 {
-	XTextProperty prop;
-	if (wm->status != NULL)
-		XFree(wm->status);
-	wm->status = NULL;
-	if (XGetWMName(wm->dpy, wm->root, &prop))
-		wm->status = (unsigned char*) prop.value;
+	unsigned int hash = 5381;
+	int i;
+
+	for (i = 0; i < len; i++)
+		hash = hash * 33 + (unsigned char) str[i];
+	return hash;
 }
 
-void render_bar(Wm *wm)
+long now_ms(void)
 {
-	int size;
-	int i;
-	int y;
-	char wp, wn;
-	Client *cli;
-	XGlyphInfo extents;
-	unsigned char buf[128];
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
 
-	XClearWindow(wm->dpy, wm->bar);
-	XftDraw	*xftdraw = XftDrawCreate(wm->dpy, wm->bar, DefaultVisual(wm->dpy, 0), DefaultColormap(wm->dpy, 0));
+/* Arms the timer to fire at most ms milliseconds from now. */
+void set_timer(Wm *wm, int timer, long ms)
+{
+	long at = now_ms() + ms;
+	if (wm->timers[timer] == 0 || at < wm->timers[timer])
+		wm->timers[timer] = at;
+}
 
-	if ((cli = wm->workspaces->current) != NULL) {
-		size = strlen((char*) cli->name);
-		size = size < MAX_WNAME_CHAR ? size : MAX_WNAME_CHAR;
-		XftTextExtentsUtf8(wm->dpy, wm->xftfont, (unsigned char*) cli->name, size, &extents);
-		XftDrawStringUtf8(xftdraw, &wm->xftcolor, wm->xftfont, extents.x, wm->bar_y, cli->name, size);
-	} else {
-		XftTextExtentsUtf8(wm->dpy, wm->xftfont, (unsigned char*) "<no client>", 11, &extents);
-		XftDrawStringUtf8(xftdraw, &wm->xftcolor, wm->xftfont, extents.x, wm->bar_y, (unsigned char*) "<no client>", 11);
+pid_t spawn(const char **command)
+{
+	pid_t pid = fork();
+	if (pid == 0) {
+		execvp(command[0], (char * const *) command);
+		exit(1);
 	}
+	return pid;
+}
 
-	y = wm->bar_y;
+/* Starts programs until every item has as many parked instances (or
+ * instances on the way) as it asks for. */
+void pool_fill(Wm *wm)
+{
+	unsigned int i, j, n;
+	Client *c;
+	pid_t pid;
+	MenuItem *items = wm->conf.items;
 
-	/* Workspace thing. */
-	wp = wm->workspaces->prev == NULL ? ' ' : '<';
-	wn = wm->workspaces->next == NULL ? ' ' : '>';
-	sprintf((char*) buf, "%c%d%c", wp, wm->n_works, wn);
-	size = strlen((char*) buf);
-	XftTextExtentsUtf8(wm->dpy, wm->xftfont, buf, size, &extents);
-	wm->ww = extents.x + extents.width;
-	XftDrawStringUtf8(xftdraw, &wm->xftcolor, wm->xftfont, extents.x + wm->wx, y, buf, size);
+	/* Forget the ones that died before mapping a window. */
+	for (j = 0; j < wm->n_pending;) {
+		if (kill(wm->pool_pending[j].pid, 0) != 0)
+			wm->pool_pending[j] = wm->pool_pending[--wm->n_pending];
+		else
+			j++;
+	}
 
-	/* Buttons. */
-	XftTextExtentsUtf8(wm->dpy, wm->xftfont, (unsigned char*) wincmds[0], 4, &extents);
-	wm->hidex = wm->sw / 4 + extents.x;
-	wm->hidew = extents.width;
-	XftDrawStringUtf8(xftdraw, &wm->xftcolor, wm->xftfont, wm->hidex, y, (unsigned char*) wincmds[0], 4);
+	for (i = 0; i < wm->conf.n_items; i++) {
+		n = 0;
+		for (c = wm->parked; c != NULL; c = c->next)
+			n += c->pool == &items[i];
+		for (j = 0; j < wm->n_pending; j++)
+			n += wm->pool_pending[j].item == &items[i];
+
+		for (; n < items[i].pool && items[i].command != NULL && wm->n_pending < MAX_POOL; n++) {
+			if ((pid = spawn(items[i].command)) <= 0)
+				break;
+			wm->pool_pending[wm->n_pending].pid = pid;
+			wm->pool_pending[wm->n_pending].item = &items[i];
+			wm->n_pending++;
+		}
+	}
+}
 
-	XftTextExtentsUtf8(wm->dpy, wm->xftfont, (unsigned char*) wincmds[1], 4, &extents);
-	wm->zoomx = wm->hidex + wm->hidew + extents.x + MENU_PADDING;
-	wm->zoomw = extents.width;
-	XftDrawStringUtf8(xftdraw, &wm->xftcolor, wm->xftfont, wm->zoomx, y, (unsigned char*) wincmds[1], 4);
+void set_state(Wm *wm, Client *c, long state)
+{
+	long data[] = { state, None };
+	XChangeProperty(wm->dpy, c->id, wm->wm_state, wm->wm_state, 32, PropModeReplace, (unsigned char*) data, 2);
+}
 
-	XftTextExtentsUtf8(wm->dpy, wm->xftfont, (unsigned char*) wincmds[2], 5, &extents);
-	wm->closex = wm->zoomx + wm->zoomw + extents.x + MENU_PADDING;
-	wm->closew = extents.width;
-	XftDrawStringUtf8(xftdraw, &wm->xftcolor, wm->xftfont, wm->closex, y, (unsigned char*) wincmds[2], 5);
+short int should_freeze(Client *c, XClassHint *hint)
+{
+	short int r = 0;
+	int i;
 
-	XftTextExtentsUtf8(wm->dpy, wm->xftfont, (unsigned char*) wincmds[3], 5, &extents);
-	wm->floatx = wm->closex + wm->closew + extents.x + MENU_PADDING;
-	wm->floatw = extents.width;
-	XftDrawStringUtf8(xftdraw, &wm->xftcolor, wm->xftfont, wm->floatx, y, (unsigned char*) wincmds[3], 5);
+	if (!FREEZE_INACTIVE || c->pid <= 0)
+		return 0;
 
-	XftTextExtentsUtf8(wm->dpy, wm->xftfont, (unsigned char*) wincmds[4], 4, &extents);
-	wm->movex = wm->floatx + wm->floatw + extents.x + MENU_PADDING;
-	wm->movew = extents.width;
-	XftDrawStringUtf8(xftdraw, &wm->xftcolor, wm->xftfont, wm->movex, y, (unsigned char*) wincmds[4], 4);
+	for (i = 0; i < LENGTH(freeze) && !r; i++) {
+		r = (hint->res_class != NULL && !strcmp(hint->res_class, freeze[i]))
+			|| (hint->res_name != NULL && !strcmp(hint->res_name, freeze[i]));
+	}
+	return r;
+}
 
-	/* Custom buttons. */
-	XftTextExtentsUtf8(wm->dpy, wm->xftfont, (unsigned char*) items[0].label, items[0].size, &extents);
-	items[0].x = wm->movex + wm->movew + extents.x + MENU_PADDING * 3;
-	items[0].w = extents.width;
-	XftDrawStringUtf8(xftdraw, &wm->xftcolor, wm->xftfont, items[0].x, y, (unsigned char*) items[0].label, items[0].size);
+/* Parent of a process, from /proc/pid/stat, or 0. */
+pid_t parent_of(pid_t pid)
+{
+	char path[64];
+	char buf[512];
+	char *p;
+	ssize_t n;
+	int fd;
+
+	sprintf(path, "/proc/%d/stat", (int) pid);
+	if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0)
+		return 0;
+	n = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+	if (n <= 0)
+		return 0;
+	buf[n] = '\0';
+	/* The name may have spaces and parentheses, but not after it. */
+	if ((p = strrchr(buf, ')')) == NULL || strlen(p) < 4)
+		return 0;
+	return strtol(p + 4, NULL, 10);
+}
 
-	for (i = 1; i < LENGTH(items); i++) {
-		XftTextExtentsUtf8(wm->dpy, wm->xftfont, (unsigned char*) items[i].label, items[i].size, &extents);
-		items[i].x = items[i-1].x + items[i-1].w + extents.x + MENU_PADDING;
-		items[i].w = extents.width;
-		XftDrawStringUtf8(xftdraw, &wm->xftcolor, wm->xftfont, items[i].x, y, (unsigned char*) items[i].label, items[i].size);
+/* Puts the process and the ones it started, and the ones they started, in
+ * tree, up to max. Browsers do most of their work in processes started
+ * by the one that owns the windows. */
+unsigned int program_tree(pid_t pid, pid_t *tree, unsigned int max)
+{
+	pid_t *procs = NULL, *parents = NULL;
+	unsigned int n = 0, size = 0, n_tree = 0, i, j;
+	struct dirent *d;
+	DIR *dir;
+
+	tree[n_tree++] = pid;
+	if ((dir = opendir("/proc")) == NULL)
+		return n_tree;
+	while ((d = readdir(dir)) != NULL) {
+		if (d->d_name[0] < '1' || d->d_name[0] > '9')
+			continue;
+		if (n == size) {
+			size = size ? size * 2 : 512;
+			procs = realloc(procs, sizeof(pid_t) * size);
+			parents = realloc(parents, sizeof(pid_t) * size);
+			assert(procs != NULL && parents != NULL && "Buy more ram lol");
+		}
+		procs[n] = atoi(d->d_name);
+		parents[n] = parent_of(procs[n]);
+		n++;
 	}
+	closedir(dir);
 
-	if (wm->status != NULL) {
-		size = strlen((char*) wm->status);
-		XftTextExtentsUtf8(wm->dpy, wm->xftfont, wm->status, size, &extents);
-		XftDrawStringUtf8(xftdraw, &wm->xftcolor, wm->xftfont, extents.x + (wm->sw - extents.width), y, wm->status, size);
+	for (i = 0; i < n_tree; i++) {
+		for (j = 0; j < n && n_tree < max; j++) {
+			if (parents[j] == tree[i])
+				tree[n_tree++] = procs[j];
+		}
 	}
-
-	XftDrawDestroy(xftdraw);
+	free(procs);
+	free(parents);
+	return n_tree;
 }
 
-void movewin(Wm *wm)
+/* A program may have windows in several workspaces, so it's stopped and
+ * resumed as a whole, and only once. Each process is added to the list
+ * before being stopped, so the signal handlers can't miss it. */
+void stop_program(pid_t pid)
 {
-	XEvent ev;
-	Window _dumb;
-	unsigned int _dumbu;
-	int x, y;
-	unsigned int w, h;
-	Client *c = wm->workspaces->current;
-	short int resizing = 0;
+	pid_t tree[MAX_STOPPED];
+	unsigned int i, n;
 
-	if (c == NULL || !c->is_float)
-		return;
-
-	XGetGeometry(wm->dpy, c->id, &_dumb, &x, &y, &w, &h, &_dumbu, &_dumbu);
-
-	XWarpPointer(wm->dpy, wm->root, wm->root, 0, 0, 0, 0, x + w/2, y + h/2);
-	XFlush(wm->dpy);
+	for (i = 0; i < n_stopped; i++) {
+		if (stopped_by[i] == pid)
+			return;
+	}
+	n = program_tree(pid, tree, MAX_STOPPED - n_stopped);
+	for (i = 0; i < n; i++) {
+		stopped[n_stopped] = tree[i];
+		stopped_by[n_stopped++] = pid;
+		if (kill(tree[i], SIGSTOP) != 0)
+			n_stopped--;
+	}
+}
 
-	XGrabPointer(
-		wm->dpy,
-		wm->root,
-		True,
-		PointerMotionMask | ButtonPressMask,
-		GrabModeAsync,
-		GrabModeAsync,
-		None,
-		wm->cursors.sizing,
-		CurrentTime);
+void resume_program(pid_t pid)
+{
+	unsigned int i = n_stopped;
+
+	while (i-- > 0) {
+		if (stopped_by[i] == pid) {
+			kill(stopped[i], SIGCONT);
+			n_stopped--;
+			stopped[i] = stopped[n_stopped];
+			stopped_by[i] = stopped_by[n_stopped];
+		}
+	}
+}
 
-	for (;;) {
-		XSync(wm->dpy, False);
-		XNextEvent(wm->dpy, &ev);
-
-		switch (ev.type) {
-		case MotionNotify:
-			if (resizing) {
-				XGetGeometry(wm->dpy, c->id, &_dumb, &x, &y, &w, &h, &_dumbu, &_dumbu);
-				if (ev.xmotion.x_root - x > 0 && ev.xmotion.y_root - y > 0)
-					XResizeWindow(wm->dpy, c->id, ev.xmotion.x_root - x, ev.xmotion.y_root - y);
-			} else {
-				XGetGeometry(wm->dpy, c->id, &_dumb, &x, &y, &w, &h, &_dumbu, &_dumbu);
-				XMoveWindow(wm->dpy, c->id, ev.xmotion.x_root - w/2, ev.xmotion.y_root - h/2);
-			}
-			break;
-		case ButtonPress:
-			if (ev.xbutton.button == Button3) {
-				resizing = !resizing;
-				if (resizing) {
-					XGetGeometry(wm->dpy, c->id, &_dumb, &x, &y, &w, &h, &_dumbu, &_dumbu);
-					XWarpPointer(wm->dpy, None, wm->root, 0, 0, 0, 0, x + w, y + h);
-				} else {
-					XGetGeometry(wm->dpy, c->id, &_dumb, &x, &y, &w, &h, &_dumbu, &_dumbu);
-					XWarpPointer(wm->dpy, None, wm->root, 0, 0, 0, 0, x + w/2, y + h/2);
-				}
-			} else {
-				goto out;
-			}
-			break;
-		default:
-			handle_event(wm, &ev);
-			break;
+/* Whether the program has a window in w, or anywhere if w is NULL. */
+short int has_window(Wm *wm, Workspace *w, pid_t pid)
+{
+	Client *c;
+	unsigned int i;
+
+	for (i = 0; i < wm->n_works; i++) {
+		if (w != NULL && wm->works[i] != w)
+			continue;
+		for (c = wm->works[i]->clients; c != NULL; c = c->next) {
+			if (c->pid == pid)
+				return 1;
+		}
+		for (c = wm->works[i]->floats; c != NULL; c = c->next) {
+			if (c->pid == pid)
+				return 1;
 		}
 	}
-out:
-	XUngrabPointer(wm->dpy, CurrentTime);
+	for (c = w == NULL ? wm->hidden : NULL; c != NULL; c = c->next) {
+		if (c->pid == pid)
+			return 1;
+	}
+	return 0;
 }
 
-void update_view(Wm *wm)
+/* Programs that also have a window in the workspace shown keep running. */
+void signal_clients(Wm *wm, Workspace *w, int sig)
 {
-	Workspace *cur = wm->workspaces;
 	Client *c;
-	int height;
-	int n;
 
-	if (cur->current == NULL)
-		goto bar;
+	for (c = w->clients; c != NULL; c = c->next) {
+		if (c->freeze && sig == SIGCONT)
+			resume_program(c->pid);
+		else if (c->freeze && !has_window(wm, wm->workspaces, c->pid))
+			stop_program(c->pid);
+	}
+	for (c = w->floats; c != NULL; c = c->next) {
+		if (c->freeze && sig == SIGCONT)
+			resume_program(c->pid);
+		else if (c->freeze && !has_window(wm, wm->workspaces, c->pid))
+			stop_program(c->pid);
+	}
+}
 
-	for (c = cur->floats; c != NULL; c = c->next) {
-		XLowerWindow(wm->dpy, c->id);
-		XSetWindowBorder(wm->dpy, c->id, BORDER_COLOR);
-		XGrabButton(wm->dpy,
-			AnyButton,
-			AnyModifier,
-			c->id,
-			False,
-			ButtonPressMask,
-			GrabModeAsync,
-			GrabModeSync,
-			None,
-			None);
-		n++;
+/* Workspaces that weren't shown for FREEZE_DELAY have their listed
+ * programs stopped. Waiting avoids stopping and resuming them when
+ * switching quickly through workspaces. */
+void freeze_timer(Wm *wm)
+{
+	Workspace *w;
+	long now = now_ms();
+	unsigned int i;
+
+	for (i = 0; i < wm->n_works; i++) {
+		w = wm->works[i];
+		if (w == wm->workspaces || w->freeze_at == 0)
+			continue;
+		if (w->freeze_at <= now) {
+			signal_clients(wm, w, SIGSTOP);
+			w->freeze_at = 0;
+		} else {
+			set_timer(wm, TimerFreeze, w->freeze_at - now);
+		}
 	}
+}
 
-	if (cur->n_cli == 0)
-		goto focus;
+void leave_workspace(Wm *wm, Workspace *w)
+{
+	Client *c;
 
-	if (cur->n_cli == 1) {
-		XLowerWindow(wm->dpy, cur->clients->id);
-		XMoveResizeWindow(wm->dpy, cur->clients->id, 0, wm->bar_height, wm->sw - BORDER_WIDTH * 2, wm->sh - wm->bar_height - BORDER_WIDTH * 2);
-		XSetWindowBorder(wm->dpy, cur->clients->id, BORDER_COLOR);
-		XGrabButton(wm->dpy,
-			AnyButton,
-			AnyModifier,
-			cur->clients->id,
-			False,
-			ButtonPressMask,
-			GrabModeAsync,
-			GrabModeSync,
-			None,
-			None);
-		goto focus;
-	}
+	if (!FREEZE_INACTIVE)
+		return;
 
-	XLowerWindow(wm->dpy, cur->clients->id);
-	XMoveResizeWindow(wm->dpy, cur->clients->id, 0, wm->bar_height, wm->sw / 2 - BORDER_WIDTH * 2, wm->sh - BORDER_WIDTH * 2 - wm->bar_height);
-	XSetWindowBorder(wm->dpy, cur->clients->id, BORDER_COLOR);
-	XGrabButton(wm->dpy,
-		AnyButton,
-		AnyModifier,
-		cur->clients->id,
-		False,
-		ButtonPressMask,
-		GrabModeAsync,
-		GrabModeSync,
-		None,
-		None);
+	for (c = w->clients; c != NULL; c = c->next)
+		set_state(wm, c, IconicState);
+	for (c = w->floats; c != NULL; c = c->next)
+		set_state(wm, c, IconicState);
 
-	n = 0;
-	height = (wm->sh - wm->bar_height) / (cur->n_cli - 1);
+	w->freeze_at = now_ms() + FREEZE_DELAY;
+	set_timer(wm, TimerFreeze, FREEZE_DELAY);
+}
 
-	for (c = cur->clients->next; c != NULL; c = c->next) {
-		XLowerWindow(wm->dpy, c->id);
-		XMoveResizeWindow(wm->dpy, c->id, wm->sw / 2, n * height + wm->bar_height, wm->sw / 2 - BORDER_WIDTH * 2, height - BORDER_WIDTH * 2);
-		XSetWindowBorder(wm->dpy, c->id, BORDER_COLOR);
-		XGrabButton(wm->dpy,
-			AnyButton,
-			AnyModifier,
-			c->id,
-			False,
-			ButtonPressMask,
-			GrabModeAsync,
-			GrabModeSync,
-			None,
-			None);
-		n++;
-	}
+void enter_workspace(Wm *wm, Workspace *w)
+{
+	Client *c;
 
-focus:
-	XSetWindowBorder(wm->dpy, cur->current->id, BORDER_FOCUS);
-	XSetInputFocus(wm->dpy, cur->current->id, RevertToParent, CurrentTime);
-	XUngrabButton(wm->dpy, AnyButton, AnyModifier, cur->current->id);
+	if (!FREEZE_INACTIVE)
+		return;
 
-bar:
-	render_bar(wm);
+	/* Its programs may have been stopped with another workspace, even
+	 * if this one was left too recently to be frozen. */
+	signal_clients(wm, w, SIGCONT);
+	w->freeze_at = 0;
+
+	for (c = w->clients; c != NULL; c = c->next)
+		set_state(wm, c, NormalState);
+	for (c = w->floats; c != NULL; c = c->next)
+		set_state(wm, c, NormalState);
 }
 
-void new_workspace(Wm *wm)
+/* Item the window was started for, if it's one of the pool ones. */
+MenuItem *pool_claim(Wm *wm, pid_t pid)
 {
-	Workspace *w = wm->workspaces;
-	w->next = malloc(sizeof(Workspace));
-	assert(w->next != NULL && "Buy more ram lol");
+	unsigned int j;
+	MenuItem *item;
 
-	w->next->prev = w;
-	w->next->next = NULL;
-	wm->n_works++;
+	if (pid <= 0)
+		return NULL;
 
-	w->next->n_cli = 0;
-	w->next->n_float = 0;
-	w->next->clients = NULL;
-	w->next->floats = NULL;
-	w->next->current = NULL;
+	for (j = 0; j < wm->n_pending; j++) {
+		if (wm->pool_pending[j].pid == pid) {
+			item = wm->pool_pending[j].item;
+			wm->pool_pending[j] = wm->pool_pending[--wm->n_pending];
+			return item;
+		}
+	}
+	return NULL;
 }
 
-void manage(Wm *wm, Window win)
+/* Built-in status modules. Each one writes what it shows in buf, or
+ * nothing if it has nothing to show, and keeps its files open in m. */
+
+void mod_clock(Wm *wm, ModuleState *m, const char *arg, char *buf)
 {
-	XTextProperty prop;
-	Client *new = malloc(sizeof(Client));
-	assert(new != NULL && "Buy more ram lol");
+	struct tm tm;
+	time_t t = time(NULL);
 
-	new->id = win;
-	new->is_float = 0;
+	localtime_r(&t, &tm);
+	if (strftime(buf, MODULE_TEXT, arg, &tm) == 0)
+		buf[0] = '\0';
+}
+
+/* Busy time over all time since the last run, from the first line of
+ * /proc/stat. */
+void mod_cpu(Wm *wm, ModuleState *m, const char *arg, char *buf)
+{
+	char s[256];
+	char *p = s + 3;
+	unsigned long long v, idle = 0, total = 0, didle;
+	ssize_t n;
+	int i;
+
+	buf[0] = '\0';
+	if (m->fd < 0 && (m->fd = open("/proc/stat", O_RDONLY | O_CLOEXEC)) < 0)
+		return;
+	if ((n = pread(m->fd, s, sizeof(s) - 1, 0)) <= 3)
+		return;
+	s[n] = '\0';
+
+	/* user nice system idle iowait irq softirq steal */
+	for (i = 0; i < 8; i++) {
+		v = strtoull(p, &p, 10);
+		total += v;
+		if (i == 3 || i == 4)
+			idle += v;
+	}
+	/* The kernel's iowait count can go backwards, taking the idle time
+	 * with it, so its change is kept between 0 and the total's. */
+	if (m->prev[1] != 0 && total > m->prev[1]) {
+		didle = idle > m->prev[0] ? idle - m->prev[0] : 0;
+		if (didle > total - m->prev[1])
+			didle = total - m->prev[1];
+		sprintf(buf, "cpu %llu%%", 100 - didle * 100 / (total - m->prev[1]));
+	}
+	m->prev[0] = idle;
+	m->prev[1] = total;
+}
+
+void mod_mem(Wm *wm, ModuleState *m, const char *arg, char *buf)
+{
+	char s[256];
+	char *total, *avail;
+	unsigned long t;
+	ssize_t n;
+
+	buf[0] = '\0';
+	if (m->fd < 0 && (m->fd = open("/proc/meminfo", O_RDONLY | O_CLOEXEC)) < 0)
+		return;
+	if ((n = pread(m->fd, s, sizeof(s) - 1, 0)) <= 0)
+		return;
+	s[n] = '\0';
+
+	if ((total = strstr(s, "MemTotal:")) == NULL || (avail = strstr(s, "MemAvailable:")) == NULL)
+		return;
+	if ((t = strtoul(total + 9, NULL, 10)) > 0)
+		sprintf(buf, "mem %lu%%", (t - strtoul(avail + 13, NULL, 10)) * 100 / t);
+}
+
+/* arg is the name of the battery in /sys/class/power_supply. */
+void mod_battery(Wm *wm, ModuleState *m, const char *arg, char *buf)
+{
+	char path[128];
+	char cap[8], status[16];
+	ssize_t n;
+
+	buf[0] = '\0';
+	if (m->fd < 0) {
+		snprintf(path, sizeof(path), "/sys/class/power_supply/%s/capacity", arg);
+		if ((m->fd = open(path, O_RDONLY | O_CLOEXEC)) < 0)
+			return;
+		snprintf(path, sizeof(path), "/sys/class/power_supply/%s/status", arg);
+		m->fd2 = open(path, O_RDONLY | O_CLOEXEC);
+	}
+	if ((n = pread(m->fd, cap, sizeof(cap) - 1, 0)) <= 0)
+		return;
+	cap[n] = '\0';
+	status[0] = '\0';
+	if (m->fd2 >= 0 && (n = pread(m->fd2, status, sizeof(status) - 1, 0)) > 0)
+		status[n] = '\0';
+	sprintf(buf, "bat %d%%%s", atoi(cap), status[0] == 'C' ? "+" : "");
+}
+
+/* arg is the ALSA control device, and the master volume is read from it
+ * with ioctl(), as alsamixer does, without going through a sound server.
+ * The device reports every change to its controls, so it's watched and
+ * read again only when one of the Master ones changes. */
+void mod_volume(Wm *wm, ModuleState *m, const char *arg, char *buf)
+{
+	struct snd_ctl_elem_info info;
+	struct snd_ctl_elem_value value;
+	struct snd_ctl_event ev;
+	short int changed;
+	int on = 1;
+	long range;
+	ssize_t n;
+
+	/* Without the events it's read on every run. */
+	changed = m->watch < 0;
+	if (m->fd < 0) {
+		if ((m->fd = open(arg, O_RDONLY | O_NONBLOCK | O_CLOEXEC)) < 0) {
+			buf[0] = '\0';
+			return;
+		}
+		if (ioctl(m->fd, SNDRV_CTL_IOCTL_SUBSCRIBE_EVENTS, &on) == 0)
+			m->watch = m->fd;
+	}
+
+	while ((n = read(m->fd, &ev, sizeof(ev))) == sizeof(ev))
+		if (ev.type == SNDRV_CTL_EVENT_ELEM && !strncmp((char*) ev.data.elem.id.name, "Master Playback", 15))
+			changed = 1;
+	/* The card is gone. */
+	if (n < 0 && errno != EAGAIN) {
+		close(m->fd);
+		m->fd = -1;
+		m->watch = -1;
+		buf[0] = '\0';
+		return;
+	}
+	if (!changed) {
+		strcpy(buf, m->text);
+		return;
+	}
+
+	buf[0] = '\0';
+
+	memset(&value, 0, sizeof(value));
+	value.id.iface = SNDRV_CTL_ELEM_IFACE_MIXER;
+	strcpy((char*) value.id.name, "Master Playback Switch");
+	if (ioctl(m->fd, SNDRV_CTL_IOCTL_ELEM_READ, &value) == 0 && !value.value.integer.value[0]) {
+		strcpy(buf, "vol mute");
+		return;
+	}
+
+	memset(&info, 0, sizeof(info));
+	info.id.iface = SNDRV_CTL_ELEM_IFACE_MIXER;
+	strcpy((char*) info.id.name, "Master Playback Volume");
+	if (ioctl(m->fd, SNDRV_CTL_IOCTL_ELEM_INFO, &info) < 0)
+		return;
+	memset(&value, 0, sizeof(value));
+	value.id = info.id;
+	if (ioctl(m->fd, SNDRV_CTL_IOCTL_ELEM_READ, &value) < 0)
+		return;
+	if ((range = info.value.integer.max - info.value.integer.min) > 0)
+		sprintf(buf, "vol %ld%%", (value.value.integer.value[0] - info.value.integer.min) * 100 / range);
+}
+
+/* The files of a program are opened once, however many windows it has,
+ * so they don't run tibaji out of file descriptors. */
+void open_usage(Wm *wm, Client *c)
+{
+	char path[64];
+	Usage *u;
+
+	c->usage = NULL;
+	if (!SHOW_USAGE || c->pid <= 0)
+		return;
+
+	for (u = wm->usages; u != NULL; u = u->next) {
+		if (u->pid == c->pid) {
+			u->refs++;
+			c->usage = u;
+			return;
+		}
+	}
+
+	u = malloc(sizeof(Usage));
+	assert(u != NULL && "Buy more ram lol");
+	u->pid = c->pid;
+	u->refs = 1;
+	u->ticks = 0;
+	u->sampled = 0;
+	u->cpu = 0;
+	u->rss = 0;
+	sprintf(path, "/proc/%d/stat", (int) c->pid);
+	u->stat_fd = open(path, O_RDONLY | O_CLOEXEC);
+	sprintf(path, "/proc/%d/statm", (int) c->pid);
+	u->statm_fd = open(path, O_RDONLY | O_CLOEXEC);
+	u->next = wm->usages;
+	wm->usages = u;
+	c->usage = u;
+}
+
+void close_usage(Wm *wm, Client *c)
+{
+	Usage *u = c->usage;
+	Usage **it;
+
+	if (u == NULL || --u->refs > 0)
+		return;
+
+	for (it = &wm->usages; *it != u; it = &(*it)->next);
+	*it = u->next;
+	if (u->stat_fd >= 0)
+		close(u->stat_fd);
+	if (u->statm_fd >= 0)
+		close(u->statm_fd);
+	free(u);
+}
+
+/* Reads how much CPU time and memory the program of c uses. The files are
+ * read again from the start, without opening them. */
+void sample_usage(Wm *wm, Client *c, long now)
+{
+	Usage *u = c->usage;
+	char buf[512];
+	char *p;
+	unsigned long ticks;
+	ssize_t n;
+	int i;
+
+	if (u == NULL || u->stat_fd < 0 || u->sampled == now)
+		return;
+
+	if ((n = pread(u->stat_fd, buf, sizeof(buf) - 1, 0)) <= 0)
+		return;
+	buf[n] = '\0';
+	/* The program name may have spaces and parens in it, so the
+	 * fields are counted from the last paren, which ends the second.
+	 * The CPU time in user and kernel mode are the 14th and 15th. */
+	p = strrchr(buf, ')');
+	for (i = 0; i < 12 && p != NULL; i++)
+		p = strchr(p + 1, ' ');
+	if (p == NULL)
+		return;
+	ticks = strtoul(p + 1, &p, 10);
+	ticks += strtoul(p, NULL, 10);
+
+	if (u->sampled != 0 && now > u->sampled)
+		u->cpu = (ticks - u->ticks) * 1000 / wm->clock_ticks * 100 / (now - u->sampled);
+	u->ticks = ticks;
+	u->sampled = now;
+
+	/* Resident pages come after the total. */
+	if (u->statm_fd >= 0 && (n = pread(u->statm_fd, buf, sizeof(buf) - 1, 0)) > 0) {
+		buf[n] = '\0';
+		strtoul(buf, &p, 10);
+		u->rss = strtoul(p, NULL, 10) * wm->page_kb;
+	}
+}
+
+void usage_text(Client *c, char *buf)
+{
+	Usage *u = c != NULL ? c->usage : NULL;
+
+	if (u == NULL || u->sampled == 0)
+		buf[0] = '\0';
+	else if (u->rss >= 1024 * 1024)
+		sprintf(buf, "%u%% %.1fG", u->cpu, u->rss / (1024.0 * 1024.0));
+	else
+		sprintf(buf, "%u%% %luM", u->cpu, u->rss / 1024);
+}
+
+/* Asks fontconfig for a font covering cp, based on the main one. */
+XftFont *fallback_font(Wm *wm, FcChar32 cp)
+{
+	FcPattern *pat, *match;
+	FcCharSet *cs;
+	FcResult result;
+	XftFont *f;
+
+	pat = FcPatternDuplicate(wm->xftfont->pattern);
+	cs = FcCharSetCreate();
+	FcCharSetAddChar(cs, cp);
+	FcPatternDel(pat, FC_CHARSET);
+	FcPatternAddCharSet(pat, FC_CHARSET, cs);
+	FcPatternAddBool(pat, FC_SCALABLE, FcTrue);
+	FcConfigSubstitute(NULL, pat, FcMatchPattern);
+	FcDefaultSubstitute(pat);
+	match = XftFontMatch(wm->dpy, wm->screen, pat, &result);
+	FcCharSetDestroy(cs);
+	FcPatternDestroy(pat);
+
+	if (match == NULL)
+		return NULL;
+	if ((f = XftFontOpenPattern(wm->dpy, match)) == NULL) {
+		FcPatternDestroy(match);
+		return NULL;
+	}
+	if (!XftCharExists(wm->dpy, f, cp)) {
+		XftFontClose(wm->dpy, f);
+		return NULL;
+	}
+	return f;
+}
+
+/* Index in wm->fonts of the font used to draw cp. Lookups are cached, and
+ * fontconfig is only asked when no loaded font has the glyph. Codepoints
+ * no font has are drawn with the main font. */
+int font_for(Wm *wm, FcChar32 cp)
+{
+	GlyphCache *g = &wm->glyphs[cp % GLYPH_CACHE];
+	XftFont *f;
+	int i;
+
+	if (g->font >= 0 && g->cp == cp)
+		return g->font;
+
+	g->cp = cp;
+	g->font = 0;
+
+	for (i = 0; i < wm->n_fonts; i++) {
+		if (XftCharExists(wm->dpy, wm->fonts[i], cp)) {
+			g->font = i;
+			return i;
+		}
+	}
+
+	if (wm->n_fonts < MAX_FONTS && (f = fallback_font(wm, cp)) != NULL) {
+		g->font = wm->n_fonts;
+		wm->fonts[wm->n_fonts++] = f;
+	}
+
+	return g->font;
+}
+
+/* Splits the text of t in runs of the same font and measures them. */
+void shape(Wm *wm, Title *t)
+{
+	XGlyphInfo extents;
+	FcChar32 cp;
+	TextRun *r = NULL;
+	int i, n, font;
+
+	t->n_runs = 0;
+
+	for (i = 0; i < t->len; i += n) {
+		n = FcUtf8ToUcs4((FcChar8*) t->str + i, &cp, t->len - i);
+		/* Invalid bytes are left to the main font. */
+		font = n > 0 ? font_for(wm, cp) : 0;
+		n = n > 0 ? n : 1;
+		if (r == NULL || r->font != font) {
+			r = &t->runs[t->n_runs++];
+			r->font = font;
+			r->off = i;
+			r->len = 0;
+		}
+		r->len += n;
+	}
+
+	t->x = 0;
+	t->width = 0;
+	for (i = 0; i < t->n_runs; i++) {
+		r = &t->runs[i];
+		XftTextExtentsUtf8(wm->dpy, wm->fonts[r->font], (FcChar8*) t->str + r->off, r->len, &extents);
+		if (i == 0)
+			t->x = extents.x;
+		r->x = t->width;
+		t->width += extents.xOff;
+	}
+}
+
+void draw_title(Wm *wm, XftDraw *d, Title *t, int x, int y)
+{
+	TextRun *r;
+
+	for (r = t->runs; r < t->runs + t->n_runs; r++)
+		XftDrawStringUtf8(d, &wm->xftcolor, wm->fonts[r->font], x + t->x + r->x, y, (FcChar8*) t->str + r->off, r->len);
+}
+
+/* Bytes taken by a title of len bytes and its runs, at most one per
+ * byte. The runs start at *runs. */
+size_t title_size(int len, size_t *runs)
+{
+	*runs = (sizeof(Title) + len + 1 + sizeof(TextRun) - 1) / sizeof(TextRun) * sizeof(TextRun);
+	return (*runs + sizeof(TextRun) * (len > 0 ? len : 1) + sizeof(void*) - 1) / sizeof(void*) * sizeof(void*);
+}
+
+/* Window titles are all cut to MAX_WNAME_CHAR bytes, so they are taken
+ * from an arena of slots that size, TITLE_SLOTS at a time, and their
+ * slots are used again once they are let go. The status is longer, but
+ * there's only one at a time, so it's allocated by itself. */
+Title *title_alloc(Wm *wm, int len)
+{
+	size_t runs, size;
+	char *block;
+	Title *t;
+	int i;
+
+	if (len > MAX_WNAME_CHAR) {
+		size = title_size(len, &runs);
+		t = malloc(size);
+		assert(t != NULL && "Buy more ram lol");
+		t->slot = 0;
+	} else {
+		size = title_size(MAX_WNAME_CHAR, &runs);
+		if (wm->free_titles == NULL) {
+			block = malloc(size * TITLE_SLOTS);
+			assert(block != NULL && "Buy more ram lol");
+			for (i = 0; i < TITLE_SLOTS; i++) {
+				t = (Title*) (block + size * i);
+				t->next = wm->free_titles;
+				wm->free_titles = t;
+			}
+		}
+		t = wm->free_titles;
+		wm->free_titles = t->next;
+		t->slot = 1;
+	}
+	t->runs = (TextRun*) ((char*) t + runs);
+	return t;
+}
+
+/* Returns the interned text for str, cut to max bytes. */
+Title *title_get(Wm *wm, const char *str, int len, int max)
+{
+	unsigned int hash;
+	Title *t;
+
+	/* Only the part drawn on the bar is kept. Don't cut an UTF-8
+	 * sequence in half. */
+	if (len > max) {
+		len = max;
+		while (len > 0 && (str[len] & 0xc0) == 0x80)
+			len--;
+	}
+
+	hash = hash_str(str, len);
+	for (t = wm->titles[hash % TITLE_BUCKETS]; t != NULL; t = t->next) {
+		if (t->hash == hash && t->len == len && !memcmp(t->str, str, len)) {
+			t->refs++;
+			return t;
+		}
+	}
+
+	t = title_alloc(wm, len);
+	memcpy(t->str, str, len);
+	t->str[len] = '\0';
+	t->len = len;
+	t->hash = hash;
+	t->refs = 1;
+	shape(wm, t);
+
+	t->next = wm->titles[hash % TITLE_BUCKETS];
+	wm->titles[hash % TITLE_BUCKETS] = t;
+	return t;
+}
+
+void title_put(Wm *wm, Title *t)
+{
+	Title **it;
+
+	if (t == NULL || --t->refs > 0)
+		return;
+
+	for (it = &wm->titles[t->hash % TITLE_BUCKETS]; *it != t; it = &(*it)->next);
+	*it = t->next;
+	if (t->slot) {
+		t->next = wm->free_titles;
+		wm->free_titles = t;
+	} else {
+		free(t);
+	}
+}
+
+Pending *request(Wm *wm, Window win, void (*done)(Wm *wm, Pending *p))
+{
+	Pending *p = malloc(sizeof(Pending));
+	assert(p != NULL && "Buy more ram lol");
+
+	p->win = win;
+	p->scanned = 0;
+	p->again = 0;
+	p->n = 0;
+	p->got = 0;
+	p->done = done;
+	p->next = NULL;
+	*wm->pending_tail = p;
+	wm->pending_tail = &p->next;
+	return p;
+}
+
+void request_property(Wm *wm, Pending *p, Atom prop, Atom type, long words)
+{
+	p->seq[p->n] = xcb_get_property(wm->xcb, 0, p->win, prop, type, 0, words).sequence;
+	p->replies[p->n++] = NULL;
+}
+
+Pending *requested(Wm *wm, Window win, void (*done)(Wm *wm, Pending *p))
+{
+	Pending *p;
+
+	for (p = wm->pending; p != NULL; p = p->next) {
+		if (p->win == win && p->done == done)
+			return p;
+	}
+	return NULL;
+}
+
+/* Hands the replies that arrived to their callbacks. Replies come in the
+ * order the requests were made, so it stops at the first one missing.
+ * Returns if anything was done. */
+short int poll_replies(Wm *wm)
+{
+	Pending *p;
+	xcb_generic_error_t *err;
+	short int any = 0;
+	int i;
+
+	while ((p = wm->pending) != NULL) {
+		while (p->got < p->n) {
+			err = NULL;
+			if (!xcb_poll_for_reply(wm->xcb, p->seq[p->got], &p->replies[p->got], &err))
+				return any;
+			free(err);
+			p->got++;
+		}
+
+		wm->pending = p->next;
+		if (wm->pending == NULL)
+			wm->pending_tail = &wm->pending;
+		p->done(wm, p);
+		for (i = 0; i < p->n; i++)
+			free(p->replies[i]);
+		free(p);
+		any = 1;
+	}
+
+	return any;
+}
+
+/* Shows the part of the bar buffer between x and x + w. While a window is
+ * moved as an outline, the outline may be drawn over the bar, and copying
+ * over it would leave a piece behind when it's erased, so the bar is only
+ * shown again once the move is done. */
+void flush_bar(Wm *wm, int x, int w)
+{
+	if (OUTLINE_MOVE && wm->mode == ModeMove)
+		return;
+	XCopyArea(wm->dpy, wm->bar_buf, wm->bar, wm->bar_gc, x, 0, w, wm->bar_height, x, 0);
+}
+
+/* Draws the command buttons, which only change with the font. */
+void render_buttons(Wm *wm)
+{
+	int i;
+	int y = wm->bar_y;
+	XGlyphInfo extents;
+	XftDraw	*xftdraw = wm->bar_draw;
+	MenuItem *items = wm->conf.items;
+
+	XFillRectangle(wm->dpy, wm->bar_buf, wm->bar_gc, 0, 0, wm->sw, wm->bar_height);
+
+	XftTextExtentsUtf8(wm->dpy, wm->xftfont, (unsigned char*) "[88]", 4, &extents);
+	wm->wcell = extents.xOff + wm->conf.menu_padding;
+
+	XftTextExtentsUtf8(wm->dpy, wm->xftfont, (unsigned char*) wincmds[0], 4, &extents);
+	wm->hidex = wm->sw / 4 + extents.x;
+	wm->hidew = extents.width;
+	XftDrawStringUtf8(xftdraw, &wm->xftcolor, wm->xftfont, wm->hidex, y, (unsigned char*) wincmds[0], 4);
+
+	XftTextExtentsUtf8(wm->dpy, wm->xftfont, (unsigned char*) wincmds[1], 4, &extents);
+	wm->zoomx = wm->hidex + wm->hidew + extents.x + wm->conf.menu_padding;
+	wm->zoomw = extents.width;
+	XftDrawStringUtf8(xftdraw, &wm->xftcolor, wm->xftfont, wm->zoomx, y, (unsigned char*) wincmds[1], 4);
+
+	XftTextExtentsUtf8(wm->dpy, wm->xftfont, (unsigned char*) wincmds[2], 5, &extents);
+	wm->closex = wm->zoomx + wm->zoomw + extents.x + wm->conf.menu_padding;
+	wm->closew = extents.width;
+	XftDrawStringUtf8(xftdraw, &wm->xftcolor, wm->xftfont, wm->closex, y, (unsigned char*) wincmds[2], 5);
+
+	XftTextExtentsUtf8(wm->dpy, wm->xftfont, (unsigned char*) wincmds[3], 5, &extents);
+	wm->floatx = wm->closex + wm->closew + extents.x + wm->conf.menu_padding;
+	wm->floatw = extents.width;
+	XftDrawStringUtf8(xftdraw, &wm->xftcolor, wm->xftfont, wm->floatx, y, (unsigned char*) wincmds[3], 5);
+
+	XftTextExtentsUtf8(wm->dpy, wm->xftfont, (unsigned char*) wincmds[4], 4, &extents);
+	wm->movex = wm->floatx + wm->floatw + extents.x + wm->conf.menu_padding;
+	wm->movew = extents.width;
+	XftDrawStringUtf8(xftdraw, &wm->xftcolor, wm->xftfont, wm->movex, y, (unsigned char*) wincmds[4], 4);
+
+	/* Custom buttons. */
+	XftTextExtentsUtf8(wm->dpy, wm->xftfont, (unsigned char*) items[0].label, items[0].size, &extents);
+	items[0].x = wm->movex + wm->movew + extents.x + wm->conf.menu_padding * 3;
+	items[0].w = extents.width;
+	XftDrawStringUtf8(xftdraw, &wm->xftcolor, wm->xftfont, items[0].x, y, (unsigned char*) items[0].label, items[0].size);
+
+	for (i = 1; i < wm->conf.n_items; i++) {
+		XftTextExtentsUtf8(wm->dpy, wm->xftfont, (unsigned char*) items[i].label, items[i].size, &extents);
+		items[i].x = items[i-1].x + items[i-1].w + extents.x + wm->conf.menu_padding;
+		items[i].w = extents.width;
+		XftDrawStringUtf8(xftdraw, &wm->xftcolor, wm->xftfont, items[i].x, y, (unsigned char*) items[i].label, items[i].size);
+	}
+
+	wm->statusx = items[i-1].x + items[i-1].w + wm->conf.menu_padding;
+
+	/* Everything else has to be drawn again. */
+	title_put(wm, wm->bar_name);
+	title_put(wm, wm->bar_status);
+	wm->bar_name = NULL;
+	wm->bar_status = NULL;
+	wm->bar_works[0] = '\0';
+	wm->bar_dirty = 1;
+	flush_bar(wm, 0, wm->sw);
+}
+
+void render_bar(Wm *wm);
+
+/* Lays the modules out from the right end of the bar, each in a slot as
+ * wide as the widest text it has shown, and draws them. */
+void place_modules(Wm *wm)
+{
+	XGlyphInfo extents;
+	ModuleState *m;
+	int x = wm->sw;
+	int i;
+
+	for (i = wm->n_mods - 1; i >= 0; i--) {
+		m = &wm->mods[i];
+		XftTextExtentsUtf8(wm->dpy, wm->xftfont, (unsigned char*) m->text, strlen(m->text), &extents);
+		if (extents.xOff > m->w)
+			m->w = extents.xOff;
+		/* The ones that don't fit after the buttons aren't shown. */
+		if (x - m->w < wm->statusx) {
+			for (; i >= 0; i--)
+				wm->mods[i].x = -1;
+			break;
+		}
+		x -= m->w;
+		m->x = x;
+		if (m->w > 0)
+			x -= wm->conf.menu_padding * 2;
+	}
+	if (x < wm->statusx)
+		x = wm->statusx;
+	wm->mods_w = wm->sw - x;
+
+	XFillRectangle(wm->dpy, wm->bar_buf, wm->bar_gc, x, 0, wm->mods_w, wm->bar_height);
+	for (i = 0; i < wm->n_mods; i++) {
+		m = &wm->mods[i];
+		if (m->x >= 0)
+			XftDrawStringUtf8(wm->bar_draw, &wm->xftcolor, wm->xftfont, m->x, wm->bar_y, (unsigned char*) m->text, strlen(m->text));
+	}
+}
+
+/* Draws the text a module has changed to in its own slot. If it doesn't
+ * fit, the slots are laid out again with the rest of the status. */
+void draw_module(Wm *wm, ModuleState *m)
+{
+	XGlyphInfo extents;
+	int len = strlen(m->text);
+
+	if (m->x < 0)
+		return;
+	XftTextExtentsUtf8(wm->dpy, wm->xftfont, (unsigned char*) m->text, len, &extents);
+	if (extents.xOff > m->w) {
+		wm->mods_dirty = 1;
+		render_bar(wm);
+		return;
+	}
+	XFillRectangle(wm->dpy, wm->bar_buf, wm->bar_gc, m->x, 0, m->w, wm->bar_height);
+	XftDrawStringUtf8(wm->bar_draw, &wm->xftcolor, wm->xftfont, m->x, wm->bar_y, (unsigned char*) m->text, len);
+	flush_bar(wm, m->x, m->w);
+}
+
+/* Runs a module, drawing what it shows if it changed, and sets when it
+ * runs next. One with no interval waits for its watch file, or runs every
+ * MODULE_POLL milliseconds while it has none (its device may be missing,
+ * or unable to report changes). */
+void run_module(Wm *wm, int i)
+{
+	char buf[MODULE_TEXT];
+	ModuleState *m = &wm->mods[i];
+	long now = now_ms();
+
+	modules[i].fn(wm, m, modules[i].arg, buf);
+	if (strcmp(buf, m->text)) {
+		strcpy(m->text, buf);
+		draw_module(wm, m);
+	}
+
+	if (modules[i].interval > 0)
+		m->next = now + modules[i].interval;
+	else if (m->watch < 0)
+		m->next = now + MODULE_POLL;
+	else
+		m->next = -1;
+	if (m->next >= 0)
+		set_timer(wm, TimerModules, m->next - now);
+}
+
+/* Runs the modules whose time has come, and waits for the next one. */
+void modules_timer(Wm *wm)
+{
+	ModuleState *m;
+	long now = now_ms();
+	long next = 0;
+	int i;
+
+	for (i = 0; i < wm->n_mods; i++) {
+		m = &wm->mods[i];
+		if (m->next >= 0 && m->next <= now)
+			run_module(wm, i);
+		if (m->next >= 0 && (next == 0 || m->next < next))
+			next = m->next;
+	}
+
+	if (next != 0)
+		set_timer(wm, TimerModules, next > now ? next - now : 0);
+}
+
+/* Draws the usage text of a client ending at right, over what may be
+ * under it. */
+void draw_usage(Wm *wm, Drawable dst, XftDraw *d, const char *text, int right, int top)
+{
+	XGlyphInfo extents;
+	int len = strlen(text);
+
+	XftTextExtentsUtf8(wm->dpy, wm->xftfont, (unsigned char*) text, len, &extents);
+	XFillRectangle(wm->dpy, dst, wm->bar_gc, right - extents.xOff - wm->conf.menu_padding, top, extents.xOff + wm->conf.menu_padding, wm->bar_height);
+	XftDrawStringUtf8(d, &wm->xftcolor, wm->xftfont, right - extents.xOff, top + wm->bar_y, (unsigned char*) text, len);
+}
+
+/* The bar is kept in a pixmap, and each section is drawn there again only
+ * when what it shows changes. The window is updated from the pixmap, so
+ * exposures and unrelated changes draw no text. */
+void render_bar(Wm *wm)
+{
+	int size, x, width;
+	unsigned int i, cells, cur;
+	Client *cli;
+	Title *name;
+	XGlyphInfo extents;
+	XRectangle clip;
+	char buf[128];
+	char label[16];
+	char usage[32];
+	XftDraw	*xftdraw = wm->bar_draw;
+
+	name = (cli = wm->workspaces->current) != NULL ? cli->name : NULL;
+	usage_text(cli, usage);
+	if (name != wm->bar_name || strcmp(usage, wm->bar_usage) || wm->bar_dirty) {
+		XFillRectangle(wm->dpy, wm->bar_buf, wm->bar_gc, 0, 0, wm->wx, wm->bar_height);
+		if (name != NULL) {
+			draw_title(wm, xftdraw, name, 0, wm->bar_y);
+			name->refs++;
+		} else {
+			XftTextExtentsUtf8(wm->dpy, wm->xftfont, (unsigned char*) "<no client>", 11, &extents);
+			XftDrawStringUtf8(xftdraw, &wm->xftcolor, wm->xftfont, extents.x, wm->bar_y, (unsigned char*) "<no client>", 11);
+		}
+		if (usage[0] != '\0')
+			draw_usage(wm, wm->bar_buf, xftdraw, usage, wm->wx - wm->conf.menu_padding, 0);
+		title_put(wm, wm->bar_name);
+		wm->bar_name = name;
+		strcpy(wm->bar_usage, usage);
+		flush_bar(wm, 0, wm->wx);
+	}
+
+	/* Workspace thing. One cell per workspace, the current one in
+	 * brackets. The first ones are left out if they don't fit. */
+	cur = wm->switch_to >= 0 ? wm->switch_to : wm->n_cur;
+	cells = (wm->hidex - wm->wx) / wm->wcell;
+	cells = cells > 0 ? cells : 1;
+	wm->wfirst = cur >= cells ? cur - cells + 1 : 0;
+	sprintf(buf, "%u %u %u", wm->wfirst, cur, wm->n_works);
+	if (strcmp(buf, wm->bar_works) || wm->bar_dirty) {
+		XFillRectangle(wm->dpy, wm->bar_buf, wm->bar_gc, wm->wx, 0, wm->hidex - wm->wx, wm->bar_height);
+		for (i = wm->wfirst; i < wm->n_works && i < wm->wfirst + cells; i++) {
+			sprintf(label, i == cur ? "[%u]" : "%u", i + 1);
+			size = strlen(label);
+			XftTextExtentsUtf8(wm->dpy, wm->xftfont, (unsigned char*) label, size, &extents);
+			XftDrawStringUtf8(xftdraw, &wm->xftcolor, wm->xftfont, extents.x + wm->wx + (i - wm->wfirst) * wm->wcell, wm->bar_y, (unsigned char*) label, size);
+		}
+		wm->ww = (i - wm->wfirst) * wm->wcell;
+		strcpy(wm->bar_works, buf);
+		flush_bar(wm, wm->wx, wm->hidex - wm->wx);
+	}
+
+	if (wm->bar_dirty || wm->mods_dirty) {
+		/* With another font the slots start again from the text. */
+		if (wm->bar_dirty) {
+			for (i = 0; i < wm->n_mods; i++)
+				wm->mods[i].w = 0;
+		}
+		place_modules(wm);
+	}
+
+	if (wm->status != wm->bar_status || wm->bar_dirty || wm->mods_dirty) {
+		width = wm->sw - wm->mods_w - wm->statusx;
+		XFillRectangle(wm->dpy, wm->bar_buf, wm->bar_gc, wm->statusx, 0, width, wm->bar_height);
+		if (wm->status != NULL) {
+			/* A status wider than its section is cut on the left, so
+			 * it doesn't go over the buttons. */
+			x = wm->sw - wm->mods_w - wm->status->width;
+			if (x < wm->statusx) {
+				clip.x = wm->statusx;
+				clip.y = 0;
+				clip.width = width;
+				clip.height = wm->bar_height;
+				XftDrawSetClipRectangles(xftdraw, 0, 0, &clip, 1);
+			}
+			draw_title(wm, xftdraw, wm->status, x, wm->bar_y);
+			if (x < wm->statusx)
+				XftDrawSetClip(xftdraw, NULL);
+			wm->status->refs++;
+		}
+		title_put(wm, wm->bar_status);
+		wm->bar_status = wm->status;
+		flush_bar(wm, wm->statusx, wm->sw - wm->statusx);
+	}
+
+	wm->bar_dirty = 0;
+	wm->mods_dirty = 0;
+}
+
+/* The tiled clients of each workspace, its floating ones, and after
+ * the last workspace the hidden clients. */
+Client *usage_list(Wm *wm, unsigned int i)
+{
+	if (i < wm->n_works * 2)
+		return i % 2 ? wm->works[i / 2]->floats : wm->works[i / 2]->clients;
+	return wm->hidden;
+}
+
+/* Samples USAGE_BATCH clients at each tick, going round all of them from
+ * where the last tick stopped, so the cost doesn't grow with the number
+ * of windows. The current client is sampled every time, as it's the one
+ * shown on the bar. */
+void usage_timer(Wm *wm)
+{
+	Client *c = wm->usage_at;
+	long now = now_ms();
+	unsigned int n = 0, lists = 0;
+
+	/* Each list is started at most once, for when there are fewer
+	 * clients than a batch. */
+	while (n < USAGE_BATCH && lists <= wm->n_works * 2 + 1) {
+		if (c == NULL) {
+			if (wm->usage_list > wm->n_works * 2)
+				wm->usage_list = 0;
+			c = usage_list(wm, wm->usage_list++);
+			lists++;
+			continue;
+		}
+		sample_usage(wm, c, now);
+		c = c->next;
+		n++;
+	}
+	wm->usage_at = c;
+
+	if (wm->workspaces->current != NULL)
+		sample_usage(wm, wm->workspaces->current, now);
+	render_bar(wm);
+	set_timer(wm, TimerUsage, USAGE_INTERVAL);
+}
+
+/* Gives the window a new geometry, unless it already has it. Returns if
+ * it changed. */
+short int resize(Wm *wm, Client *c, int x, int y, int w, int h)
+{
+	if (c->x == x && c->y == y && c->w == w && c->h == h)
+		return 0;
+	c->x = x;
+	c->y = y;
+	c->w = w;
+	c->h = h;
+	XMoveResizeWindow(wm->dpy, c->id, x, y, w, h);
+	return 1;
+}
+
+void draw_outline(Wm *wm, GC gc, int x, int y, unsigned int w, unsigned int h)
+{
+	XDrawRectangle(wm->dpy, wm->root, gc, x, y, w + wm->conf.border_width, h + wm->conf.border_width);
+}
+
+void movewin(Wm *wm)
+{
+	XGCValues gcv;
+	Client *c = wm->workspaces->current;
+
+	if (wm->mode != ModeNormal || c == NULL || !c->is_float)
+		return;
+
+	wm->mode = ModeMove;
+	wm->grabbed = c;
+	wm->resizing = 0;
+	wm->gx = c->x;
+	wm->gy = c->y;
+	wm->gw = c->w;
+	wm->gh = c->h;
+
+	XWarpPointer(wm->dpy, wm->root, wm->root, 0, 0, 0, 0, c->x + c->w/2, c->y + c->h/2);
+
+	XGrabPointer(
+		wm->dpy,
+		wm->root,
+		True,
+		PointerMotionMask | ButtonPressMask,
+		GrabModeAsync,
+		GrabModeAsync,
+		None,
+		wm->cursors.sizing,
+		CurrentTime);
+
+	/* In outline mode a rectangle is drawn over everything instead, and
+	 * the window only gets the final geometry. The server is grabbed so
+	 * nothing draws over the rectangle while it's shown. */
+	if (OUTLINE_MOVE) {
+		gcv.function = GXxor;
+		gcv.foreground = WhitePixel(wm->dpy, wm->screen);
+		gcv.line_width = wm->conf.border_width;
+		gcv.subwindow_mode = IncludeInferiors;
+		wm->outline = XCreateGC(wm->dpy, wm->root, GCFunction | GCForeground | GCLineWidth | GCSubwindowMode, &gcv);
+		XGrabServer(wm->dpy);
+		draw_outline(wm, wm->outline, wm->gx, wm->gy, wm->gw, wm->gh);
+	}
+}
+
+void end_move(Wm *wm)
+{
+	if (OUTLINE_MOVE) {
+		draw_outline(wm, wm->outline, wm->gx, wm->gy, wm->gw, wm->gh);
+		XFreeGC(wm->dpy, wm->outline);
+		XUngrabServer(wm->dpy);
+	}
+	resize(wm, wm->grabbed, wm->gx, wm->gy, wm->gw, wm->gh);
+	XUngrabPointer(wm->dpy, CurrentTime);
+	wm->grabbed = NULL;
+	wm->mode = ModeNormal;
+	if (OUTLINE_MOVE)
+		flush_bar(wm, 0, wm->sw);
+}
+
+void move_event(Wm *wm, XEvent *ev)
+{
+	switch (ev->type) {
+	case MotionNotify:
+		/* Only the last position matters. */
+		while (XCheckTypedEvent(wm->dpy, MotionNotify, ev));
+		if (OUTLINE_MOVE)
+			draw_outline(wm, wm->outline, wm->gx, wm->gy, wm->gw, wm->gh);
+		if (wm->resizing) {
+			if (ev->xmotion.x_root - wm->gx > 0 && ev->xmotion.y_root - wm->gy > 0) {
+				wm->gw = ev->xmotion.x_root - wm->gx;
+				wm->gh = ev->xmotion.y_root - wm->gy;
+			}
+		} else {
+			wm->gx = ev->xmotion.x_root - wm->gw/2;
+			wm->gy = ev->xmotion.y_root - wm->gh/2;
+		}
+		if (OUTLINE_MOVE)
+			draw_outline(wm, wm->outline, wm->gx, wm->gy, wm->gw, wm->gh);
+		else
+			resize(wm, wm->grabbed, wm->gx, wm->gy, wm->gw, wm->gh);
+		break;
+	case ButtonPress:
+		if (ev->xbutton.button != Button3) {
+			end_move(wm);
+			break;
+		}
+		wm->resizing = !wm->resizing;
+		if (wm->resizing)
+			XWarpPointer(wm->dpy, None, wm->root, 0, 0, 0, 0, wm->gx + wm->gw, wm->gy + wm->gh);
+		else
+			XWarpPointer(wm->dpy, None, wm->root, 0, 0, 0, 0, wm->gx + wm->gw/2, wm->gy + wm->gh/2);
+		break;
+	}
+}
+
+/* Gives a tiled client its cell, which includes the border. */
+void tile(Wm *wm, Client *c, int x, int y, int w, int h)
+{
+	resize(wm, c, x, y, w - wm->conf.border_width * 2, h - wm->conf.border_width * 2);
+}
+
+/* Puts the handle over the border at x, or hides it if x is -1. */
+void place_handle(Wm *wm, int x)
+{
+	if (x == wm->handle_x)
+		return;
+	if (x < 0) {
+		XUnmapWindow(wm->dpy, wm->handle);
+	} else {
+		XMoveResizeWindow(wm->dpy, wm->handle, x - wm->conf.border_width - 2, wm->bar_height, wm->conf.border_width * 2 + 4, wm->sh - wm->bar_height);
+		if (wm->handle_x < 0)
+			XMapWindow(wm->dpy, wm->handle);
+	}
+	wm->handle_x = x;
+}
+
+/* Gives the tiled clients of the current workspace their cells, and puts
+ * the handle on the border between the master and the stack. Only the
+ * windows whose cell changes get a request, and that's all that's done
+ * while the border is dragged. */
+void arrange(Wm *wm)
+{
+	Workspace *cur = wm->workspaces;
+	Client *c;
+	int height;
+	int n;
+	unsigned int m = cur->n_master < cur->n_cli ? cur->n_master : cur->n_cli;
+	int mw = m == 0 ? 0 : m == cur->n_cli ? wm->sw : wm->sw * cur->mfact;
+
+	place_handle(wm, m > 0 && m < cur->n_cli ? mw : -1);
+
+	/* The first n_master clients share the master column, and the rest
+	 * the stack. */
+	for (n = 0, c = cur->clients; c != NULL; c = c->next, n++) {
+		if (n < m) {
+			height = (wm->sh - wm->bar_height) / m;
+			tile(wm, c, 0, n * height + wm->bar_height, mw, height);
+		} else {
+			height = (wm->sh - wm->bar_height) / (cur->n_cli - m);
+			tile(wm, c, mw, (n - m) * height + wm->bar_height, wm->sw - mw, height);
+		}
+	}
+}
+
+void update_view(Wm *wm)
+{
+	Workspace *cur = wm->workspaces;
+	XWindowChanges wc;
+	Client *c;
+	long start = record_time();
+
+	arrange(wm);
+
+	if (cur->current == NULL)
+		goto bar;
+
+	for (c = cur->floats; c != NULL; c = c->next) {
+		XLowerWindow(wm->dpy, c->id);
+		XSetWindowBorder(wm->dpy, c->id, wm->conf.border_color);
+		XGrabButton(wm->dpy,
+			AnyButton,
+			AnyModifier,
+			c->id,
+			False,
+			ButtonPressMask,
+			GrabModeAsync,
+			GrabModeSync,
+			None,
+			None);
+	}
+
+	if (cur->n_cli == 0)
+		goto focus;
+
+	for (c = cur->clients; c != NULL; c = c->next) {
+		XLowerWindow(wm->dpy, c->id);
+		XSetWindowBorder(wm->dpy, c->id, wm->conf.border_color);
+		XGrabButton(wm->dpy,
+			AnyButton,
+			AnyModifier,
+			c->id,
+			False,
+			ButtonPressMask,
+			GrabModeAsync,
+			GrabModeSync,
+			None,
+			None);
+	}
+
+	/* Tiled clients are at the bottom, the first one above the others,
+	 * so the handle goes right above it and below the floating ones. */
+	if (wm->handle_x >= 0) {
+		wc.sibling = cur->clients->id;
+		wc.stack_mode = Above;
+		XConfigureWindow(wm->dpy, wm->handle, CWSibling | CWStackMode, &wc);
+	}
+
+focus:
+	XSetWindowBorder(wm->dpy, cur->current->id, wm->conf.border_focus);
+	XSetInputFocus(wm->dpy, cur->current->id, RevertToParent, CurrentTime);
+	XUngrabButton(wm->dpy, AnyButton, AnyModifier, cur->current->id);
+	record(RecFocus, 0, 0, cur->current->id, 0);
+
+bar:
+	render_bar(wm);
+	record(RecLayout, cur->n_cli, cur->n_float, 0, start);
+}
+
+void new_workspace(Wm *wm)
+{
+	Workspace *w = malloc(sizeof(Workspace));
+	assert(w != NULL && "Buy more ram lol");
+
+	if (wm->n_works == wm->works_size) {
+		wm->works_size = wm->works_size ? wm->works_size * 2 : 8;
+		wm->works = realloc(wm->works, sizeof(Workspace*) * wm->works_size);
+		assert(wm->works != NULL && "Buy more ram lol");
+	}
+	wm->works[wm->n_works++] = w;
+
+	w->n_cli = 0;
+	w->n_float = 0;
+	w->clients = NULL;
+	w->floats = NULL;
+	w->current = NULL;
+	w->freeze_at = 0;
+	w->mfact = MFACT;
+	w->n_master = NMASTER;
+}
+
+void build_rules(Wm *wm)
+{
+	int i, b;
+	int *tail[RULE_BUCKETS + 1];
+
+	wm->rule_next = NULL;
+	if (LENGTH(rules) > 0) {
+		wm->rule_next = malloc(sizeof(int) * LENGTH(rules));
+		assert(wm->rule_next != NULL && "Buy more ram lol");
+	}
+
+	for (b = 0; b <= RULE_BUCKETS; b++) {
+		wm->rule_heads[b] = -1;
+		tail[b] = &wm->rule_heads[b];
+	}
+
+	/* Appended, so each chain keeps the order of config.h. */
+	for (i = 0; i < LENGTH(rules); i++) {
+		b = rules[i].class == NULL ? RULE_BUCKETS : hash_str(rules[i].class, strlen(rules[i].class)) % RULE_BUCKETS;
+		wm->rule_next[i] = -1;
+		*tail[b] = i;
+		tail[b] = &wm->rule_next[i];
+	}
+}
+
+short int rule_matches(const Rule *r, XClassHint *hint, Title *name)
+{
+	return (r->class == NULL || (hint->res_class != NULL && !strcmp(r->class, hint->res_class)))
+		&& (r->instance == NULL || (hint->res_name != NULL && !strcmp(r->instance, hint->res_name)))
+		&& (r->title == NULL || (name != NULL && strstr(name->str, r->title) != NULL));
+}
+
+/* Applies the rules matching the window, in the order of config.h, so
+ * later ones win. Only the rules for its class and the ones for any class
+ * are looked at. */
+void apply_rules(Wm *wm, XClassHint *hint, Title *name, short int *is_float, short int *hidden, unsigned int *workspace)
+{
+	int a = wm->rule_heads[RULE_BUCKETS];
+	int b = -1;
+	int i;
+
+	if (hint->res_class != NULL)
+		b = wm->rule_heads[hash_str(hint->res_class, strlen(hint->res_class)) % RULE_BUCKETS];
+
+	while (a >= 0 || b >= 0) {
+		if (b < 0 || (a >= 0 && a < b)) {
+			i = a;
+			a = wm->rule_next[a];
+		} else {
+			i = b;
+			b = wm->rule_next[b];
+		}
+		if (!rule_matches(&rules[i], hint, name))
+			continue;
+		*is_float = rules[i].is_float;
+		*hidden = rules[i].hidden;
+		*workspace = rules[i].workspace;
+	}
+}
+
+/* Puts a new client where the rules say, hidden or in a workspace, and
+ * shows it if it's in the current one. */
+void place(Wm *wm, Client *new, short int hidden, unsigned int target)
+{
+	Workspace *w;
+
+	if (hidden) {
+		new->is_float = 0;
+		new->prev = NULL;
+		new->next = wm->hidden;
+		if (wm->hidden != NULL)
+			wm->hidden->prev = new;
+		wm->hidden = new;
+		wm->n_hidden++;
+		XUnmapWindow(wm->dpy, new->id);
+		return;
+	}
+
+	w = target > 0 && target <= wm->n_works ? wm->works[target - 1] : wm->workspaces;
 	new->prev = NULL;
-	new->next = wm->workspaces->clients;
-	if (wm->workspaces->clients != NULL)
-		wm->workspaces->clients->prev = new;
-	wm->workspaces->clients = new;
-	wm->workspaces->current = new;
-	wm->workspaces->n_cli++;
+	if (new->is_float) {
+		new->next = w->floats;
+		if (w->floats != NULL)
+			w->floats->prev = new;
+		w->floats = new;
+		w->n_float++;
+		/* Centered, unless it asked for a position. */
+		if (new->x == 0 && new->y == 0)
+			resize(wm, new, (wm->sw - new->w) / 2, (wm->sh - new->h) / 2, new->w, new->h);
+	} else {
+		new->next = w->clients;
+		if (w->clients != NULL)
+			w->clients->prev = new;
+		w->clients = new;
+		w->n_cli++;
+	}
+	w->current = new;
 
-	if (wm->workspaces->n_cli == 1)
+	/* The last workspace is always kept empty. */
+	if (w == wm->works[wm->n_works - 1])
 		new_workspace(wm);
 
-	new->name = NULL;
-	if (XGetWMName(wm->dpy, win, &prop))
-		new->name = (unsigned char*) prop.value;
-
 	XGrabButton(wm->dpy,
 		AnyButton,
 		AnyModifier,
-		win,
+		new->id,
 		False,
 		ButtonPressMask,
 		GrabModeAsync,
@@ -470,30 +2153,174 @@ void manage(Wm *wm, Window win)
 		None,
 		None);
 
-	XSelectInput(wm->dpy,
-		win,
-		PointerMotionMask
-		| PropertyChangeMask);
+	/* Windows for other workspaces are mapped when switching to them. */
+	if (w != wm->workspaces) {
+		XUnmapWindow(wm->dpy, new->id);
+		if (FREEZE_INACTIVE)
+			set_state(wm, new, IconicState);
+		render_bar(wm);
+		return;
+	}
+
+	if (new->is_float)
+		XMapRaised(wm->dpy, new->id);
+	else
+		XMapWindow(wm->dpy, new->id);
+	if (FREEZE_INACTIVE)
+		set_state(wm, new, NormalState);
+
+	update_view(wm);
+}
+
+void manage(Wm *wm, Window win, WindowInfo *info)
+{
+	short int hidden = 0;
+	unsigned int target = 0;
+	Client *new = malloc(sizeof(Client));
+	assert(new != NULL && "Buy more ram lol");
+
+	new->id = win;
+	new->name = NULL;
+	new->x = info->x;
+	new->y = info->y;
+	new->w = info->w;
+	new->h = info->h;
+	if (info->name != NULL)
+		new->name = title_get(wm, info->name, info->name_len, MAX_WNAME_CHAR);
+	new->pid = info->pid;
+	new->pool = pool_claim(wm, new->pid);
+	open_usage(wm, new);
+
+	/* Where the window goes is decided before it's laid out, also for
+	 * pool windows, which keep it until they are shown. */
+	new->is_float = info->is_float;
+	new->freeze = info->local && should_freeze(new, &info->hint);
+	apply_rules(wm, &info->hint, new->name, &new->is_float, &hidden, &target);
+	new->rule_hidden = hidden;
+	new->rule_workspace = target;
+
+	XSetWindowBorder(wm->dpy, win, wm->conf.border_color);
+	XSetWindowBorderWidth(wm->dpy, win, wm->conf.border_width);
+	XSelectInput(wm->dpy, win, PropertyChangeMask);
+
+	/* Pool windows are mapped off-screen, so they are ready to be shown
+	 * when asked for. */
+	if (new->pool != NULL) {
+		new->prev = NULL;
+		new->next = wm->parked;
+		if (wm->parked != NULL)
+			wm->parked->prev = new;
+		wm->parked = new;
+
+		resize(wm, new, wm->sw, wm->sh, new->w, new->h);
+		XMapWindow(wm->dpy, win);
+		return;
+	}
+
+	place(wm, new, hidden, target);
+}
+
+/* Everything manage() needs is asked at once, so it costs one round trip
+ * that doesn't block the event loop. */
+void map_done(Wm *wm, Pending *p)
+{
+	xcb_get_window_attributes_reply_t *a = p->replies[0];
+	xcb_get_geometry_reply_t *g = p->replies[1];
+	xcb_get_property_reply_t *r;
+	WindowInfo info;
+	uint32_t *v;
+	char *str;
+	int len, n;
+
+	if (a == NULL || g == NULL || a->override_redirect || managed(wm, p->win))
+		return;
+	if (p->scanned && (a->map_state != XCB_MAP_STATE_VIEWABLE || p->win == wm->bar || p->win == wm->cli_win))
+		return;
+
+	info.x = g->x;
+	info.y = g->y;
+	info.w = g->width;
+	info.h = g->height;
+
+	info.pid = 0;
+	if ((r = p->replies[2]) != NULL && r->format == 32 && xcb_get_property_value_length(r) >= 4)
+		info.pid = *(uint32_t*) xcb_get_property_value(r);
+
+	/* The pid of a program on another machine (as with ssh -X) is some
+	 * other process here. Without WM_CLIENT_MACHINE it can't be told,
+	 * and the pid is only used to tell windows apart, never to stop it. */
+	info.local = 0;
+	if ((r = p->replies[7]) != NULL && (len = xcb_get_property_value_length(r)) > 0) {
+		str = xcb_get_property_value(r);
+		info.local = len == strlen(wm->host) && !strncmp(str, wm->host, len);
+		if (!info.local)
+			info.pid = 0;
+	}
+
+	/* WM_CLASS is the instance and the class, one after the other. */
+	info.hint.res_name = NULL;
+	info.hint.res_class = NULL;
+	if ((r = p->replies[3]) != NULL && (len = xcb_get_property_value_length(r)) > 0) {
+		str = xcb_get_property_value(r);
+		info.hint.res_name = strndup(str, len);
+		n = strlen(info.hint.res_name) + 1;
+		if (n < len)
+			info.hint.res_class = strndup(str + n, len - n);
+	}
+
+	/* Transient windows and the ones that can't be resized float. */
+	info.is_float = (r = p->replies[4]) != NULL && xcb_get_property_value_length(r) >= 4
+		&& *(uint32_t*) xcb_get_property_value(r) != None;
+	if ((r = p->replies[5]) != NULL && r->format == 32 && xcb_get_property_value_length(r) >= 9 * 4) {
+		/* Flags, then position, size, minimum size and maximum size. */
+		v = xcb_get_property_value(r);
+		info.is_float |= (v[0] & PMinSize) && (v[0] & PMaxSize) && v[5] == v[7] && v[6] == v[8];
+	}
 
-	XSetWindowBorder(wm->dpy, win, BORDER_COLOR);
-	XSetWindowBorderWidth(wm->dpy, win, BORDER_WIDTH);
-	XMapWindow(wm->dpy, win);
+	info.name = NULL;
+	info.name_len = 0;
+	if ((r = p->replies[6]) != NULL && xcb_get_property_value_length(r) > 0) {
+		info.name = xcb_get_property_value(r);
+		info.name_len = xcb_get_property_value_length(r);
+	}
 
-	update_view(wm);
+	manage(wm, p->win, &info);
+
+	free(info.hint.res_name);
+	free(info.hint.res_class);
 }
 
-void map_requested(Wm *wm, XEvent *ev)
+void request_window(Wm *wm, Window win, short int scanned)
 {
-	XWindowAttributes wa;
-	XMapRequestEvent *e = &ev->xmaprequest;
-
-	if (!XGetWindowAttributes(wm->dpy, e->window, &wa)
-		|| wa.override_redirect
-		|| managed(wm, e->window))
+	Pending *p;
 
+	/* A map request for a window seen by scan() needs it managed even if
+	 * it wasn't mapped then. */
+	if ((p = requested(wm, win, map_done)) != NULL) {
+		p->scanned = p->scanned && scanned;
 		return;
+	}
+
+	p = request(wm, win, map_done);
+	p->scanned = scanned;
+	p->seq[p->n] = xcb_get_window_attributes(wm->xcb, win).sequence;
+	p->replies[p->n++] = NULL;
+	p->seq[p->n] = xcb_get_geometry(wm->xcb, win).sequence;
+	p->replies[p->n++] = NULL;
+	request_property(wm, p, wm->net_wm_pid, XA_CARDINAL, 1);
+	request_property(wm, p, XA_WM_CLASS, XA_STRING, 64);
+	request_property(wm, p, XA_WM_TRANSIENT_FOR, XA_WINDOW, 1);
+	request_property(wm, p, XA_WM_NORMAL_HINTS, XA_WM_SIZE_HINTS, 18);
+	request_property(wm, p, XA_WM_NAME, AnyPropertyType, (MAX_WNAME_CHAR + 3) / 4);
+	request_property(wm, p, XA_WM_CLIENT_MACHINE, XA_STRING, MAX_HOST / 4);
+}
+
+void map_requested(Wm *wm, XEvent *ev)
+{
+	XMapRequestEvent *e = &ev->xmaprequest;
 
-	manage(wm, e->window);
+	if (!managed(wm, e->window))
+		request_window(wm, e->window, 0);
 }
 
 void unmanage_hidden(Wm *wm, Client *c)
@@ -502,6 +2329,11 @@ void unmanage_hidden(Wm *wm, Client *c)
 		c->prev->next = c->next;
 	if (c->next != NULL)
 		c->next->prev = c->prev;
+	if (c->pool != NULL) {
+		if (wm->parked == c)
+			wm->parked = c->next;
+		return;
+	}
 	if (wm->hidden == c)
 		wm->hidden = c->next;
 	wm->n_hidden--;
@@ -510,6 +2342,7 @@ void unmanage_hidden(Wm *wm, Client *c)
 void unmanage_from_workspace(Wm *wm, Client *c, Workspace *w)
 {
 	Client *cit;
+	unsigned int i;
 	if (c->prev != NULL)
 		c->prev->next = c->next;
 	if (c->next != NULL)
@@ -538,13 +2371,19 @@ void unmanage_from_workspace(Wm *wm, Client *c, Workspace *w)
 		w->n_cli--;
 
 	if (w->n_cli == 0 && w->n_float == 0) {
-		if (w->prev != NULL)
-			w->prev->next = w->next;
-		w->next->prev = w->prev;
-		if (wm->workspaces == w)
-			wm->workspaces = w->next;
-		free(w);
+		for (i = 0; wm->works[i] != w; i++);
+		memmove(&wm->works[i], &wm->works[i + 1], sizeof(Workspace*) * (wm->n_works - i - 1));
 		wm->n_works--;
+		if (i < wm->n_cur)
+			wm->n_cur--;
+		if (wm->switch_to > (int) i)
+			wm->switch_to--;
+		/* If it was the current one, the next one takes its place. */
+		if (wm->workspaces == w) {
+			wm->workspaces = wm->works[wm->n_cur];
+			enter_workspace(wm, wm->workspaces);
+		}
+		free(w);
 
 		for (cit = wm->workspaces->clients; cit != NULL; cit = cit->next)
 			XMapWindow(wm->dpy, cit->id);
@@ -561,61 +2400,152 @@ void destroy_notify(Wm *wm, XEvent *ev)
 	FindResult r = find_window(wm, e->window);
 	if (r.c == NULL)
 		return;
+	/* The menu lists the hidden clients by position. */
+	if (r.c == wm->grabbed || (r.w == NULL && wm->mode == ModeMenu))
+		leave_mode(wm);
+	if (r.c == wm->usage_at)
+		wm->usage_at = r.c->next;
 	if (r.w == NULL)
 		unmanage_hidden(wm, r.c);
 	else
 		unmanage_from_workspace(wm, r.c, r.w);
-	if (r.c->name != NULL)
-		XFree(r.c->name);
+	/* A program whose last window is gone isn't left stopped. */
+	if (r.c->freeze && !has_window(wm, NULL, r.c->pid))
+		resume_program(r.c->pid);
+	title_put(wm, r.c->name);
+	close_usage(wm, r.c);
 	free(r.c);
 }
 
-void property_notify(Wm *wm, XEvent *ev)
+void request_name(Wm *wm, Window win);
+
+/* WM_NAME of a client, or of the root window for the status. */
+void name_done(Wm *wm, Pending *p)
 {
-	XPropertyEvent *e = &ev->xproperty;
+	xcb_get_property_reply_t *r = p->replies[0];
 	Client *c = NULL;
-	XTextProperty prop;
+	Title *t = NULL;
+	Title **dest;
 
-	if (e->window == wm->root) {
-		update_status(wm);
+	if (p->win == wm->root) {
+		dest = &wm->status;
+	} else if ((c = find_window(wm, p->win).c) != NULL) {
+		dest = &c->name;
 	} else {
-		c = find_window(wm, e->window).c;
-		if (c != NULL) {
-			if (c->name != NULL)
-				XFree(c->name);
-			c->name = NULL;
-			if (XGetWMName(wm->dpy, c->id, &prop))
-				c->name = (unsigned char*) prop.value;
-		}
+		return;
 	}
 
+	if (r != NULL && xcb_get_property_value_length(r) > 0)
+		t = title_get(wm, xcb_get_property_value(r), xcb_get_property_value_length(r), c != NULL ? MAX_WNAME_CHAR : MAX_STATUS);
+	/* Released after the lookup so an unchanged title isn't rebuilt. */
+	title_put(wm, *dest);
+	*dest = t;
+
+	/* It changed again after this was asked. */
+	if (p->again)
+		request_name(wm, p->win);
+
 	render_bar(wm);
 }
 
+/* Only the part of the name that's drawn is fetched. */
+void request_name(Wm *wm, Window win)
+{
+	Pending *p = requested(wm, win, name_done);
+
+	if (p != NULL) {
+		p->again = 1;
+		return;
+	}
+
+	p = request(wm, win, name_done);
+	request_property(wm, p, XA_WM_NAME, AnyPropertyType, ((win == wm->root ? MAX_STATUS : MAX_WNAME_CHAR) + 3) / 4);
+}
+
+void property_notify(Wm *wm, XEvent *ev)
+{
+	XPropertyEvent *e = &ev->xproperty;
+
+	if (e->atom != XA_WM_NAME)
+		return;
+
+	if (e->window == wm->root || managed(wm, e->window))
+		request_name(wm, e->window);
+}
+
 void expose(Wm *wm, XEvent *ev)
 {
 	XExposeEvent *e = &ev->xexpose;
 
 	if (e->window == wm->bar)
-		render_bar(wm);
+		flush_bar(wm, e->x, e->width);
+	else if (e->window == wm->cli_win && e->count == 0 && wm->mode == ModeLauncher)
+		draw_launcher(wm);
 }
 
-void switch_workspace(Wm *wm, short int to_next)
+/* Only the windows of the workspace left and the one shown are touched,
+ * however far apart they are. */
+void goto_workspace(Wm *wm, unsigned int n)
 {
 	Client *c;
-	Workspace *new = to_next ? wm->workspaces->next : wm->workspaces->prev;
-	if (new != NULL) {
-		for (c = wm->workspaces->clients; c != NULL; c = c->next)
-			XUnmapWindow(wm->dpy, c->id);
-		for (c = wm->workspaces->floats; c != NULL; c = c->next)
-			XUnmapWindow(wm->dpy, c->id);
-		wm->workspaces = new;
-		for (c = wm->workspaces->clients; c != NULL; c = c->next)
-			XMapWindow(wm->dpy, c->id);
-		for (c = wm->workspaces->floats; c != NULL; c = c->next)
-			XMapRaised(wm->dpy, c->id);
-		update_view(wm);
+
+	if (n >= wm->n_works || n == wm->n_cur)
+		return;
+
+	for (c = wm->workspaces->clients; c != NULL; c = c->next)
+		XUnmapWindow(wm->dpy, c->id);
+	for (c = wm->workspaces->floats; c != NULL; c = c->next)
+		XUnmapWindow(wm->dpy, c->id);
+	leave_workspace(wm, wm->workspaces);
+	wm->n_cur = n;
+	wm->workspaces = wm->works[n];
+	enter_workspace(wm, wm->workspaces);
+	for (c = wm->workspaces->clients; c != NULL; c = c->next)
+		XMapWindow(wm->dpy, c->id);
+	for (c = wm->workspaces->floats; c != NULL; c = c->next)
+		XMapRaised(wm->dpy, c->id);
+	update_view(wm);
+}
+
+void commit_switch(Wm *wm);
+
+/* A switch on its own is done at once. The ones asked for within
+ * SWITCH_DELAY of the last are merged: only the indicator follows them,
+ * and the last one is done when they stop. */
+void request_workspace(Wm *wm, int n)
+{
+	long now = now_ms();
+
+	if (n < 0 || n >= wm->n_works)
+		return;
+	wm->switch_to = n;
+	if (wm->timers[TimerSwitch] == 0 && now - wm->switched_at >= SWITCH_DELAY) {
+		commit_switch(wm);
+		return;
 	}
+	wm->timers[TimerSwitch] = now + SWITCH_DELAY;
+	render_bar(wm);
+}
+
+void commit_switch(Wm *wm)
+{
+	int n = wm->switch_to;
+
+	if (n < 0)
+		return;
+	wm->switch_to = -1;
+	wm->timers[TimerSwitch] = 0;
+	wm->switched_at = now_ms();
+	if (n == wm->n_cur)
+		render_bar(wm);
+	else
+		goto_workspace(wm, n);
+}
+
+void switch_workspace(Wm *wm, short int to_next)
+{
+	int cur = wm->switch_to >= 0 ? wm->switch_to : wm->n_cur;
+	request_workspace(wm, to_next ? cur + 1 : cur - 1);
 }
 
 void hide(Wm *wm)
@@ -707,6 +2637,50 @@ void closewin(Wm *wm)
 		XKillClient(wm->dpy, c->id);
 }
 
+/* Puts a client that isn't in any workspace as the master of the current
+ * one. */
+void attach(Wm *wm, Client *c)
+{
+	wm->workspaces->n_cli++;
+	c->prev = NULL;
+	c->next = wm->workspaces->clients;
+	if (wm->workspaces->clients != NULL)
+		wm->workspaces->clients->prev = c;
+	wm->workspaces->clients = c;
+	wm->workspaces->current = c;
+
+	/* Its program may be stopped with the windows it has elsewhere. */
+	if (c->freeze)
+		resume_program(c->pid);
+	XMapWindow(wm->dpy, c->id);
+
+	if (wm->n_cur == wm->n_works - 1)
+		new_workspace(wm);
+
+	update_view(wm);
+}
+
+/* Shows a parked instance of the item, if there's one. */
+short int pool_adopt(Wm *wm, MenuItem *item)
+{
+	Client *c;
+
+	for (c = wm->parked; c != NULL && c->pool != item; c = c->next);
+	if (c == NULL)
+		return 0;
+
+	unmanage_hidden(wm, c);
+	c->pool = NULL;
+	/* It was parked off-screen, and goes where a new window would. */
+	c->x = 0;
+	c->y = 0;
+	if (c->freeze)
+		resume_program(c->pid);
+	place(wm, c, c->rule_hidden, c->rule_workspace);
+	pool_fill(wm);
+	return 1;
+}
+
 void unhide_by_idx(Wm *wm, int idx)
 {
 	Client *c;
@@ -718,68 +2692,77 @@ void unhide_by_idx(Wm *wm, int idx)
 		idx--;
 
 	if (c != NULL) {
-		wm->n_hidden--;
-		wm->workspaces->n_cli++;
-		if (c->prev != NULL)
-			c->prev->next = c->next;
-		if (c->next != NULL)
-			c->next->prev = c->prev;
-		if (wm->hidden == c)
-			wm->hidden = c->next;
-		c->prev = NULL;
-		c->next = wm->workspaces->clients;
-		if (wm->workspaces->clients != NULL)
-			wm->workspaces->clients->prev = c;
-		wm->workspaces->clients = c;
-		wm->workspaces->current = c;
+		unmanage_hidden(wm, c);
+		attach(wm, c);
+	}
+}
 
-		XMapWindow(wm->dpy, c->id);
+short int uses_more(Client *a, Client *b)
+{
+	Usage none = { 0 };
+	Usage *ua = a->usage != NULL ? a->usage : &none;
+	Usage *ub = b->usage != NULL ? b->usage : &none;
 
-		if (wm->workspaces->n_cli == 1)
-			new_workspace(wm);
+	return ua->cpu != ub->cpu ? ua->cpu > ub->cpu : ua->rss >= ub->rss;
+}
 
-		update_view(wm);
+/* Puts the hidden clients using more CPU, then more memory, first, as
+ * last sampled. */
+void sort_hidden(Wm *wm)
+{
+	Client *sorted = NULL, *prev = NULL;
+	Client *c, *next, **it;
+
+	for (c = wm->hidden; c != NULL; c = next) {
+		next = c->next;
+		for (it = &sorted; *it != NULL && uses_more(*it, c); it = &(*it)->next);
+		c->next = *it;
+		*it = c;
 	}
+	for (c = sorted; c != NULL; c = c->next) {
+		c->prev = prev;
+		prev = c;
+	}
+	wm->hidden = sorted;
 }
 
 void hidden_window(Wm *wm)
 {
 	XGlyphInfo extents;
-	XEvent ev;
 	Client *cli;
+	char usage[32];
 	int lasty;
-	int size;
 
-	if (wm->n_hidden == 0)
+	if (wm->mode != ModeNormal || wm->n_hidden == 0)
 		return;
 
+	if (SHOW_USAGE)
+		sort_hidden(wm);
+
 	XMapWindow(wm->dpy, wm->cli_win);
 	XMoveResizeWindow(wm->dpy, wm->cli_win, 0, 0, wm->sw / 5, wm->bar_height * (wm->n_hidden + 1));
 
 	XClearWindow(wm->dpy, wm->cli_win);
-	XftDraw	*xftdraw = XftDrawCreate(wm->dpy, wm->cli_win, DefaultVisual(wm->dpy, 0), DefaultColormap(wm->dpy, 0));
+	XftDraw	*xftdraw = wm->cli_draw;
 
-	if ((cli = wm->workspaces->current) != NULL) {
-		size = strlen((char*) cli->name);
-		size = size < MAX_WNAME_CHAR ? size : MAX_WNAME_CHAR;
-		XftTextExtentsUtf8(wm->dpy, wm->xftfont, (unsigned char*) cli->name, size, &extents);
-		XftDrawStringUtf8(xftdraw, &wm->xftcolor, wm->xftfont, extents.x, extents.y + BAR_PADDING, cli->name, size);
+	if ((cli = wm->workspaces->current) != NULL && cli->name != NULL) {
+		draw_title(wm, xftdraw, cli->name, 0, wm->bar_y);
 	} else {
 		XftTextExtentsUtf8(wm->dpy, wm->xftfont, (unsigned char*) "<no client>", 11, &extents);
-		XftDrawStringUtf8(xftdraw, &wm->xftcolor, wm->xftfont, extents.x, extents.y + BAR_PADDING, (unsigned char*) "<no client>", 11);
+		XftDrawStringUtf8(xftdraw, &wm->xftcolor, wm->xftfont, extents.x, wm->bar_y, (unsigned char*) "<no client>", 11);
 	}
 
-	lasty = extents.y + BAR_PADDING;
+	lasty = wm->bar_y;
 
 	for (cli = wm->hidden; cli != NULL; cli = cli->next) {
 		lasty += wm->bar_height;
-		size = strlen((char*) cli->name);
-		XftTextExtentsUtf8(wm->dpy, wm->xftfont, (unsigned char*) cli->name, size, &extents);
-		XftDrawStringUtf8(xftdraw, &wm->xftcolor, wm->xftfont, extents.x, lasty, (unsigned char*) cli->name, size);
+		if (cli->name != NULL)
+			draw_title(wm, xftdraw, cli->name, 0, lasty);
+		usage_text(cli, usage);
+		if (usage[0] != '\0')
+			draw_usage(wm, wm->cli_win, xftdraw, usage, wm->sw / 5 - wm->conf.menu_padding, lasty - wm->bar_y);
 	}
 
-	XftDrawDestroy(xftdraw);
-
 	XGrabPointer(
 		wm->dpy,
 		wm->cli_win,
@@ -791,44 +2774,424 @@ void hidden_window(Wm *wm)
 		wm->cursors.left_ptr,
 		CurrentTime);
 
-	for (;;) {
-		XSync(wm->dpy, False);
-		XNextEvent(wm->dpy, &ev);
+	wm->mode = ModeMenu;
+}
 
-		switch (ev.type) {
-		case MotionNotify:
-			if (ev.xmotion.x_root > wm->sw / 5 || ev.xmotion.y_root > wm->bar_height * (wm->n_hidden + 1))
-				goto ungrab;
-			break;
-		case ButtonPress:
-			unhide_by_idx(wm, ev.xmotion.y_root / wm->bar_height);
-			goto ungrab;
-			break;
-		default:
-			handle_event(wm, &ev);
-			break;
+void close_menu(Wm *wm)
+{
+	XUngrabPointer(wm->dpy, CurrentTime);
+	XUnmapWindow(wm->dpy, wm->cli_win);
+	wm->mode = ModeNormal;
+}
+
+void menu_event(Wm *wm, XEvent *ev)
+{
+	switch (ev->type) {
+	case MotionNotify:
+		while (XCheckTypedEvent(wm->dpy, MotionNotify, ev));
+		if (ev->xmotion.x_root > wm->sw / 5 || ev->xmotion.y_root > wm->bar_height * (wm->n_hidden + 1))
+			close_menu(wm);
+		break;
+	case ButtonPress:
+		/* Unhiding lays the workspace out, so the menu goes first. */
+		close_menu(wm);
+		unhide_by_idx(wm, ev->xbutton.y_root / wm->bar_height);
+		break;
+	}
+}
+
+short int is_exec(int dir, const char *name)
+{
+	struct stat st;
+
+	return fstatat(dir, name, &st, 0) == 0 && S_ISREG(st.st_mode) && faccessat(dir, name, X_OK, 0) == 0;
+}
+
+/* First program from lo to hi whose first len bytes are not before
+ * (or, with after, are after) the first len bytes of name. */
+unsigned int prog_bound(Wm *wm, const char *name, int len, unsigned int lo, unsigned int hi, short int after)
+{
+	unsigned int mid;
+	int cmp;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		cmp = strncmp(wm->progs[mid], name, len);
+		if (cmp < 0 || (after && cmp == 0))
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+int prog_cmp(const void *a, const void *b)
+{
+	return strcmp(*(char**) a, *(char**) b);
+}
+
+/* Reads every PATH directory into the index. */
+void fill_progs(Wm *wm)
+{
+	struct dirent *de;
+	unsigned int i, j;
+	DIR *d;
+
+	for (i = 0; i < wm->n_progs; i++)
+		free(wm->progs[i]);
+	wm->n_progs = 0;
+
+	for (i = 0; i < wm->n_path; i++) {
+		if (wm->path_fds[i] < 0 || (d = fdopendir(dup(wm->path_fds[i]))) == NULL)
+			continue;
+		rewinddir(d);
+		while ((de = readdir(d)) != NULL) {
+			if (de->d_name[0] == '.' || !is_exec(wm->path_fds[i], de->d_name))
+				continue;
+			if (wm->n_progs == wm->progs_size) {
+				wm->progs_size = wm->progs_size ? wm->progs_size * 2 : 1024;
+				wm->progs = realloc(wm->progs, sizeof(char*) * wm->progs_size);
+				assert(wm->progs != NULL && "Buy more ram lol");
+			}
+			wm->progs[wm->n_progs] = strdup(de->d_name);
+			assert(wm->progs[wm->n_progs] != NULL && "Buy more ram lol");
+			wm->n_progs++;
 		}
+		closedir(d);
+	}
+
+	/* The same program may be in several directories. */
+	qsort(wm->progs, wm->n_progs, sizeof(char*), prog_cmp);
+	for (i = j = 0; i < wm->n_progs; i++) {
+		if (j > 0 && !strcmp(wm->progs[j - 1], wm->progs[i]))
+			free(wm->progs[i]);
+		else
+			wm->progs[j++] = wm->progs[i];
+	}
+	wm->n_progs = j;
+}
+
+/* Builds the index of programs the first time the launcher is opened,
+ * and watches the PATH directories to keep it up to date from then on. */
+void build_progs(Wm *wm)
+{
+	const char *path = getenv("PATH");
+	char *dirs, *dir;
+	unsigned int n = 1;
+
+	if (wm->progs_built)
+		return;
+	wm->progs_built = 1;
+
+	if (path == NULL)
+		path = "/usr/local/bin:/usr/bin:/bin";
+	dirs = strdup(path);
+	assert(dirs != NULL && "Buy more ram lol");
+	for (dir = dirs; *dir != '\0'; dir++)
+		n += *dir == ':';
+	wm->path_fds = malloc(sizeof(int) * n);
+	wm->path_wds = malloc(sizeof(int) * n);
+	assert(wm->path_fds != NULL && wm->path_wds != NULL && "Buy more ram lol");
+
+	for (dir = strtok(dirs, ":"); dir != NULL; dir = strtok(NULL, ":")) {
+		wm->path_fds[wm->n_path] = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+		wm->path_wds[wm->n_path] = wm->inotify < 0 ? -1 : inotify_add_watch(wm->inotify, dir,
+			IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ATTRIB | IN_ONLYDIR);
+		wm->n_path++;
+	}
+	free(dirs);
+
+	fill_progs(wm);
+}
+
+/* Adds or removes a program whose file changed in a PATH directory. */
+void update_prog(Wm *wm, const char *name)
+{
+	unsigned int i, at;
+	short int found = 0;
+	int len = strlen(name) + 1;
+
+	for (i = 0; i < wm->n_path && !found; i++)
+		found = wm->path_fds[i] >= 0 && is_exec(wm->path_fds[i], name);
+
+	at = prog_bound(wm, name, len, 0, wm->n_progs, 0);
+	if (at < wm->n_progs && !strcmp(wm->progs[at], name)) {
+		if (found)
+			return;
+		free(wm->progs[at]);
+		memmove(&wm->progs[at], &wm->progs[at + 1], sizeof(char*) * (wm->n_progs - at - 1));
+		wm->n_progs--;
+		return;
+	}
+
+	if (!found || name[0] == '.')
+		return;
+	if (wm->n_progs == wm->progs_size) {
+		wm->progs_size = wm->progs_size ? wm->progs_size * 2 : 1024;
+		wm->progs = realloc(wm->progs, sizeof(char*) * wm->progs_size);
+		assert(wm->progs != NULL && "Buy more ram lol");
+	}
+	memmove(&wm->progs[at + 1], &wm->progs[at], sizeof(char*) * (wm->n_progs - at));
+	wm->progs[at] = strdup(name);
+	assert(wm->progs[at] != NULL && "Buy more ram lol");
+	wm->n_progs++;
+}
+
+/* The programs matching are the ones starting with what's typed. Typing
+ * more only narrows the ones that matched before. */
+void match_progs(Wm *wm, short int narrow)
+{
+	if (!narrow) {
+		wm->l_lo = 0;
+		wm->l_hi = wm->n_progs;
+	}
+	wm->l_lo = prog_bound(wm, wm->l_text, wm->l_len, wm->l_lo, wm->l_hi, 0);
+	wm->l_hi = prog_bound(wm, wm->l_text, wm->l_len, wm->l_lo, wm->l_hi, 1);
+}
+
+void draw_launcher(Wm *wm)
+{
+	XGlyphInfo extents;
+	unsigned int i;
+	int y = wm->bar_y;
+
+	XClearWindow(wm->dpy, wm->cli_win);
+	XftDrawStringUtf8(wm->cli_draw, &wm->xftcolor, wm->xftfont, 0, y, (unsigned char*) wm->l_text, wm->l_len);
+	XftTextExtentsUtf8(wm->dpy, wm->xftfont, (unsigned char*) wm->l_text, wm->l_len, &extents);
+	XftDrawStringUtf8(wm->cli_draw, &wm->xftcolor, wm->xftfont, extents.xOff, y, (unsigned char*) "_", 1);
+
+	for (i = wm->l_lo; i < wm->l_hi && i < wm->l_lo + LAUNCHER_LINES; i++) {
+		y += wm->bar_height;
+		XftDrawStringUtf8(wm->cli_draw, &wm->xftcolor, wm->xftfont, 0, y, (unsigned char*) wm->progs[i], strlen(wm->progs[i]));
 	}
+}
+
+/* Opens the launcher over the bar. What's typed goes to it until a
+ * program is started or it's closed. */
+void launcher(Wm *wm)
+{
+	if (wm->mode != ModeNormal)
+		return;
+
+	build_progs(wm);
+	wm->l_len = 0;
+	wm->l_text[0] = '\0';
+	match_progs(wm, 0);
+
+	XMoveResizeWindow(wm->dpy, wm->cli_win, 0, 0, wm->sw / 5, wm->bar_height * (LAUNCHER_LINES + 1));
+	XMapRaised(wm->dpy, wm->cli_win);
+	if (XGrabKeyboard(wm->dpy, wm->root, True, GrabModeAsync, GrabModeAsync, CurrentTime) != GrabSuccess) {
+		XUnmapWindow(wm->dpy, wm->cli_win);
+		return;
+	}
+	XGrabPointer(
+		wm->dpy,
+		wm->cli_win,
+		True,
+		ButtonPressMask,
+		GrabModeAsync,
+		GrabModeAsync,
+		None,
+		wm->cursors.left_ptr,
+		CurrentTime);
+
+	if (wm->xic != NULL)
+		XSetICFocus(wm->xic);
+	wm->mode = ModeLauncher;
+	draw_launcher(wm);
+}
 
-ungrab:
+void close_launcher(Wm *wm)
+{
+	if (wm->xic != NULL)
+		XUnsetICFocus(wm->xic);
+	XUngrabKeyboard(wm->dpy, CurrentTime);
 	XUngrabPointer(wm->dpy, CurrentTime);
 	XUnmapWindow(wm->dpy, wm->cli_win);
+	wm->mode = ModeNormal;
+}
+
+/* Starts the program, or has the shell run what's typed if it has
+ * arguments. */
+void launch(Wm *wm, const char *prog)
+{
+	const char *command[] = { prog, NULL, NULL, NULL };
+
+	if (strchr(prog, ' ') != NULL) {
+		command[0] = "/bin/sh";
+		command[1] = "-c";
+		command[2] = prog;
+	}
+	spawn(command);
+	close_launcher(wm);
+}
+
+void launcher_event(Wm *wm, XEvent *ev)
+{
+	char buf[32];
+	KeySym sym = NoSymbol;
+	Status status;
+	int n, i, row;
+
+	if (ev->type == ButtonPress) {
+		row = ev->xbutton.y_root / wm->bar_height - 1;
+		if (ev->xbutton.x_root < wm->sw / 5 && row >= 0 && row < LAUNCHER_LINES && wm->l_lo + row < wm->l_hi)
+			launch(wm, wm->progs[wm->l_lo + row]);
+		else
+			close_launcher(wm);
+		return;
+	}
+
+	/* Keys that are part of a compose sequence are eaten by the input
+	 * method. XLookupString() gives Latin-1, so without one anything
+	 * that's not ASCII is dropped. */
+	if (XFilterEvent(ev, None))
+		return;
+	if (wm->xic != NULL) {
+		n = Xutf8LookupString(wm->xic, &ev->xkey, buf, sizeof(buf), &sym, &status);
+		if (status == XBufferOverflow || status == XLookupNone)
+			return;
+		if (status == XLookupChars)
+			sym = NoSymbol;
+		else if (status == XLookupKeySym)
+			n = 0;
+	} else {
+		n = XLookupString(&ev->xkey, buf, sizeof(buf), &sym, NULL);
+		for (i = 0; i < n; i++)
+			if ((unsigned char) buf[i] >= 0x80)
+				n = 0;
+	}
+
+	switch (sym) {
+	case XK_Escape:
+		close_launcher(wm);
+		return;
+	case XK_Return:
+	case XK_KP_Enter:
+		if (wm->l_len == 0)
+			close_launcher(wm);
+		else if (strchr(wm->l_text, ' ') == NULL && wm->l_lo < wm->l_hi)
+			launch(wm, wm->progs[wm->l_lo]);
+		else
+			launch(wm, wm->l_text);
+		return;
+	case XK_Tab:
+		if (wm->l_lo < wm->l_hi && strlen(wm->progs[wm->l_lo]) < sizeof(wm->l_text)) {
+			strcpy(wm->l_text, wm->progs[wm->l_lo]);
+			wm->l_len = strlen(wm->l_text);
+			match_progs(wm, 1);
+		}
+		break;
+	case XK_BackSpace:
+		/* A whole UTF-8 sequence goes. */
+		while (wm->l_len > 0 && (wm->l_text[--wm->l_len] & 0xc0) == 0x80);
+		wm->l_text[wm->l_len] = '\0';
+		match_progs(wm, 0);
+		break;
+	default:
+		if (n <= 0 || (unsigned char) buf[0] < ' ' || wm->l_len + n >= sizeof(wm->l_text))
+			return;
+		memcpy(wm->l_text + wm->l_len, buf, n);
+		wm->l_len += n;
+		wm->l_text[wm->l_len] = '\0';
+		match_progs(wm, 1);
+		break;
+	}
+	draw_launcher(wm);
+}
+
+/* Scrolling on the handle changes how many clients are in the master
+ * column, and dragging it with the left button moves it. */
+void split_press(Wm *wm, XButtonEvent *e)
+{
+	Workspace *w = wm->workspaces;
+
+	switch (e->button) {
+	case Button1:
+		XGrabPointer(
+			wm->dpy,
+			wm->root,
+			False,
+			PointerMotionMask | ButtonReleaseMask,
+			GrabModeAsync,
+			GrabModeAsync,
+			None,
+			wm->cursors.split,
+			CurrentTime);
+		wm->mode = ModeSplit;
+		break;
+	case Button4:
+		if (w->n_master + 1 < w->n_cli) {
+			w->n_master++;
+			update_view(wm);
+		}
+		break;
+	case Button5:
+		if (w->n_master > 1) {
+			w->n_master--;
+			update_view(wm);
+		}
+		break;
+	}
+}
+
+void end_split(Wm *wm)
+{
+	XUngrabPointer(wm->dpy, CurrentTime);
+	wm->mode = ModeNormal;
+	wm->timers[TimerLayout] = 0;
+	arrange(wm);
+}
+
+/* While dragging, the layout follows the pointer at most once every
+ * LAYOUT_DELAY milliseconds, and only the clients whose cell changes are
+ * resized. */
+void split_event(Wm *wm, XEvent *ev)
+{
+	float mfact;
+
+	switch (ev->type) {
+	case MotionNotify:
+		while (XCheckTypedEvent(wm->dpy, MotionNotify, ev));
+		mfact = (float) ev->xmotion.x_root / wm->sw;
+		wm->workspaces->mfact = mfact < 0.05 ? 0.05 : mfact > 0.95 ? 0.95 : mfact;
+		set_timer(wm, TimerLayout, LAYOUT_DELAY);
+		break;
+	case ButtonRelease:
+		end_split(wm);
+		break;
+	}
 }
 
 void button_press(Wm *wm, XEvent *ev)
 {
 	XButtonEvent *e = &ev->xbutton;
 	FindResult r;
+	MenuItem *items = wm->conf.items;
 	int i;
 
+	if (e->window == wm->handle) {
+		commit_switch(wm);
+		split_press(wm, e);
+		return;
+	}
+
+	if (e->window == wm->bar && e->x >= wm->wx && e->x < wm->wx + wm->ww) {
+		if (e->button == Button3 || e->button == Button5)
+			switch_workspace(wm, 1);
+		else if (e->button == Button4)
+			switch_workspace(wm, 0);
+		else
+			request_workspace(wm, wm->wfirst + (e->x - wm->wx) / wm->wcell);
+		return;
+	}
+
+	/* Anything else acts on the workspace the user is going to. */
+	commit_switch(wm);
+
 	if (e->window == wm->bar) {
 		if (e->x < wm->sw / 5) {
 			hidden_window(wm);
-		} else if (e->x >= wm->wx && e->x <= wm->wx + wm->ww) {
-			if (e->button == Button3)
-				switch_workspace(wm, 1);
-			else
-				switch_workspace(wm, 0);
 		} else if (e->x >= wm->hidex && e->x <= wm->hidex + wm->hidew) {
 			hide(wm);
 		} else if (e->x >= wm->zoomx && e->x <= wm->zoomx + wm->zoomw) {
@@ -840,12 +3203,12 @@ void button_press(Wm *wm, XEvent *ev)
 		} else if (e->x >= wm->movex && e->x <= wm->movex + wm->movew) {
 			movewin(wm);
 		} else {
-			for (i = 0; i < LENGTH(items); i++) {
+			for (i = 0; i < wm->conf.n_items; i++) {
 				if (e->x >= items[i].x && e->x <= items[i].x + items[i].w) {
-					if (fork() == 0) {
-						execvp(items[i].command[0], (char * const *) items[i].command);
-						exit(1);
-					}
+					if (items[i].command == NULL)
+						launcher(wm);
+					else if (!pool_adopt(wm, &items[i]))
+						spawn(items[i].command);
 					break;
 				}
 			}
@@ -861,54 +3224,86 @@ void button_press(Wm *wm, XEvent *ev)
 
 void fullscreen(Wm *wm)
 {
-	XEvent ev;
+	Client *c = wm->workspaces->current;
 
-	if (wm->workspaces->current == NULL)
+	if (wm->mode != ModeNormal || c == NULL)
 		return;
 
-	XSetWindowBorderWidth(wm->dpy, wm->workspaces->current->id, 0);
-	XMoveResizeWindow(wm->dpy, wm->workspaces->current->id, 0, 0, wm->sw, wm->sh);
-	XRaiseWindow(wm->dpy, wm->workspaces->current->id);
+	wm->mode = ModeFullscreen;
+	wm->grabbed = c;
+	wm->gx = c->x;
+	wm->gy = c->y;
+	wm->gw = c->w;
+	wm->gh = c->h;
 
-	for (;;) {
-		XSync(wm->dpy, False);
-		XNextEvent(wm->dpy, &ev);
-
-		switch (ev.type) {
-		case MapRequest:
-		case DestroyNotify:
-		case ButtonPress:
-			handle_event(wm, &ev);
-		case KeyPress:
-			XSetWindowBorderWidth(wm->dpy, wm->workspaces->current->id, BORDER_WIDTH);
-			update_view(wm);
-			return;
-		}
+	XSetWindowBorderWidth(wm->dpy, c->id, 0);
+	resize(wm, c, 0, 0, wm->sw, wm->sh);
+	XRaiseWindow(wm->dpy, c->id);
+}
+
+/* Gives back the border and geometry of the client that went fullscreen,
+ * which isn't necessarily the current one any more. */
+void leave_fullscreen(Wm *wm)
+{
+	Client *c = wm->grabbed;
+
+	XSetWindowBorderWidth(wm->dpy, c->id, wm->conf.border_width);
+	if (c->is_float)
+		resize(wm, c, wm->gx, wm->gy, wm->gw, wm->gh);
+	wm->grabbed = NULL;
+	wm->mode = ModeNormal;
+	update_view(wm);
+}
+
+void leave_mode(Wm *wm)
+{
+	switch (wm->mode) {
+	case ModeMove:
+		end_move(wm);
+		break;
+	case ModeMenu:
+		close_menu(wm);
+		break;
+	case ModeFullscreen:
+		leave_fullscreen(wm);
+		break;
+	case ModeSplit:
+		end_split(wm);
+		break;
+	case ModeLauncher:
+		close_launcher(wm);
+		break;
 	}
 }
 
 void redraw(Wm *wm)
 {
-	Window _dumb;
-	int x, y;
-	unsigned int w, h, _dumbi;
+	Client *c = wm->workspaces->current;
 
-	if (wm->workspaces->current != NULL) {
-		XSync(wm->dpy, False);
-		XGetGeometry(wm->dpy, wm->workspaces->current->id, &_dumb, &x, &y, &w, &h, &_dumbi, &_dumbi);
-		XSync(wm->dpy, False);
-		XMoveResizeWindow(wm->dpy, wm->workspaces->current->id, x, y, w-1, h);
-		XSync(wm->dpy, False);
-		XMoveResizeWindow(wm->dpy, wm->workspaces->current->id, x, y, w, h);
+	if (c != NULL) {
+		XMoveResizeWindow(wm->dpy, c->id, c->x, c->y, c->w - 1, c->h);
 		XSync(wm->dpy, False);
+		XMoveResizeWindow(wm->dpy, c->id, c->x, c->y, c->w, c->h);
 	}
 }
 
 void key_press(Wm *wm, XEvent *e)
 {
 	XKeyEvent *ev = &e->xkey;
+	KeySym sym;
+	int i;
 
 	if (ev->state == MODMASK) {
+		sym = XLookupKeysym(ev, 0);
+		for (i = 0; i < LENGTH(workspace_keys); i++) {
+			if (sym == workspace_keys[i]) {
+				request_workspace(wm, i);
+				return;
+			}
+		}
+
+		commit_switch(wm);
+
 		if (wm->fkey == ev->keycode)
 			fullscreen(wm);
 		else if (wm->rkey == ev->keycode)
@@ -920,29 +3315,211 @@ void key_press(Wm *wm, XEvent *e)
 	}
 }
 
+/* Tells the client its geometry without changing it, as ICCCM asks when
+ * a configure request isn't honoured. */
+void send_configure(Wm *wm, Client *c)
+{
+	XConfigureEvent ce;
+
+	ce.type = ConfigureNotify;
+	ce.display = wm->dpy;
+	ce.event = c->id;
+	ce.window = c->id;
+	ce.x = c->x;
+	ce.y = c->y;
+	ce.width = c->w;
+	ce.height = c->h;
+	ce.border_width = wm->conf.border_width;
+	ce.above = None;
+	ce.override_redirect = False;
+	XSendEvent(wm->dpy, c->id, False, StructureNotifyMask, (XEvent*) &ce);
+}
+
 void config_request(Wm *wm, XEvent *ev)
 {
-	Window _dumb;
-	int x, y, nx, ny;
-	unsigned int w, h, nw, nh, _dumbi;
+	XWindowChanges wc;
 	XConfigureRequestEvent *e = &ev->xconfigurerequest;
-
 	FindResult r = find_window(wm, e->window);
+	Client *c = r.c;
+
+	if (c == NULL) {
+		/* Not ours, it gets what it asked for. */
+		wc.x = e->x;
+		wc.y = e->y;
+		wc.width = e->width;
+		wc.height = e->height;
+		wc.border_width = e->border_width;
+		wc.sibling = e->above;
+		wc.stack_mode = e->detail;
+		XConfigureWindow(wm->dpy, e->window, e->value_mask, &wc);
+		return;
+	}
 
-	if (r.c != NULL && r.w != NULL && r.is_float) {
-		XGetGeometry(wm->dpy, e->window, &_dumb, &x, &y, &w, &h, &_dumbi, &_dumbi);
-		x = e->value_mask & CWX ? e->x : x;
-		y = e->value_mask & CWY ? e->y : y;
-		w = e->value_mask & CWWidth ? e->width : w;
-		h = e->value_mask & CWHeight ? e->height : h;
+	/* Floating windows may place themselves, tiled ones are only told
+	 * where their tile is. */
+	if (r.w != NULL && r.is_float) {
+		if (resize(wm, c,
+				e->value_mask & CWX ? e->x : c->x,
+				e->value_mask & CWY ? e->y : c->y,
+				e->value_mask & CWWidth ? e->width : c->w,
+				e->value_mask & CWHeight ? e->height : c->h))
+			return;
+	}
 
-		XMoveResizeWindow(wm->dpy, e->window, x, y, w, h);
-		XSync(wm->dpy, False);
+	send_configure(wm, c);
+}
+
+#ifdef TESTS
+/* Test builds do what the driver in tests/ asks for, through the same
+ * clicks a user would make. A mark is answered by writing on the driver's
+ * window, once everything asked before has been done, how many requests
+ * and round trips it took since the last one. What the status modules
+ * and the usage sampling take on their own clocks isn't counted. */
+enum { TestMark, TestFocus, TestButton, TestUnhide, TestWorkspace };
+enum { TestHide, TestZoom, TestFloat };
+
+/* Sequence number of the last request and round trips made by the last
+ * mark, moved forward past the ones left out, and the window of the mark
+ * waiting to be answered. */
+static unsigned int test_seq;
+static unsigned long test_trips;
+static unsigned long trips;
+static Window test_to;
+
+void handle_event(Wm *wm, XEvent *ev);
+
+/* Xlib waits for its replies through these, and so do the reply functions
+ * of XCB, so defining them here sees every round trip. */
+void *xcb_wait_for_reply(xcb_connection_t *c, unsigned int request, xcb_generic_error_t **e)
+{
+	static void *(*fn)(xcb_connection_t *c, unsigned int request, xcb_generic_error_t **e);
+
+	if (fn == NULL)
+		fn = dlsym(RTLD_NEXT, "xcb_wait_for_reply");
+	trips++;
+	return fn(c, request, e);
+}
+
+void *xcb_wait_for_reply64(xcb_connection_t *c, uint64_t request, xcb_generic_error_t **e)
+{
+	static void *(*fn)(xcb_connection_t *c, uint64_t request, xcb_generic_error_t **e);
+
+	if (fn == NULL)
+		fn = dlsym(RTLD_NEXT, "xcb_wait_for_reply64");
+	trips++;
+	return fn(c, request, e);
+}
+
+/* The sequence number of a no-op, which comes after the requests Xlib
+ * still has buffered. */
+unsigned int test_now(Wm *wm)
+{
+	return xcb_no_operation(wm->xcb).sequence;
+}
+
+void test_leave_out(Wm *wm, unsigned int seq, unsigned long t)
+{
+	test_seq += test_now(wm) - seq + 1;
+	test_trips += trips - t;
+}
+
+/* Answers the mark once tibaji has nothing left to do for what was asked
+ * before it: no events waiting to be merged, no replies waiting, and no
+ * switch or layout it's holding back. Called when it would go to sleep. */
+void test_answer(Wm *wm)
+{
+	uint32_t counts[2];
+
+	if (test_to == None || wm->n_deferred > 0 || wm->pending != NULL
+			|| wm->timers[TimerSwitch] != 0 || wm->timers[TimerLayout] != 0
+			|| wm->timers[TimerDeferred] != 0)
+		return;
+	counts[0] = test_now(wm) - 1 - test_seq;
+	counts[1] = trips - test_trips;
+	test_seq = xcb_change_property(wm->xcb, XCB_PROP_MODE_REPLACE, test_to, wm->test, XCB_ATOM_CARDINAL, 32, 2, counts).sequence;
+	test_trips = trips;
+	test_to = None;
+	xcb_flush(wm->xcb);
+}
+
+void test_message(Wm *wm, XEvent *ev)
+{
+	XClientMessageEvent *e = &ev->xclient;
+	XEvent click;
+
+	memset(&click, 0, sizeof(click));
+	click.type = ButtonPress;
+	click.xbutton.button = Button1;
+	click.xbutton.window = wm->bar;
+
+	switch (e->data.l[0]) {
+	case TestMark:
+		test_to = e->data.l[1];
+		return;
+	case TestFocus:
+		click.xbutton.window = e->data.l[1];
+		break;
+	case TestButton:
+		click.xbutton.x = 1 + (e->data.l[1] == TestHide ? wm->hidex
+			: e->data.l[1] == TestZoom ? wm->zoomx : wm->floatx);
+		break;
+	case TestUnhide:
+		/* Opens the menu and clicks its first window. */
+		handle_event(wm, &click);
+		click.xbutton.window = wm->cli_win;
+		click.xbutton.y_root = wm->bar_height + 1;
+		break;
+	case TestWorkspace:
+		click.xbutton.x = wm->wx + (e->data.l[1] - (int) wm->wfirst) * wm->wcell + 1;
+		break;
+	default:
+		return;
 	}
+	handle_event(wm, &click);
 }
+#endif
 
 void handle_event(Wm *wm, XEvent *ev)
 {
+	/* While a mode is active the pointer and the keys are its own; the
+	 * rest of the events are handled as usual. */
+	switch (wm->mode) {
+	case ModeMove:
+		if (ev->type == MotionNotify || ev->type == ButtonPress)
+			move_event(wm, ev);
+		if (ev->type == MotionNotify || ev->type == ButtonPress || ev->type == KeyPress)
+			return;
+		break;
+	case ModeMenu:
+		if (ev->type == MotionNotify || ev->type == ButtonPress)
+			menu_event(wm, ev);
+		if (ev->type == MotionNotify || ev->type == ButtonPress || ev->type == KeyPress)
+			return;
+		break;
+	case ModeLauncher:
+		if (ev->type == ButtonPress || ev->type == KeyPress) {
+			launcher_event(wm, ev);
+			return;
+		}
+		break;
+	case ModeSplit:
+		if (ev->type == MotionNotify || ev->type == ButtonRelease)
+			split_event(wm, ev);
+		if (ev->type == MotionNotify || ev->type == ButtonPress || ev->type == ButtonRelease || ev->type == KeyPress)
+			return;
+		break;
+	case ModeFullscreen:
+		/* A key only leaves fullscreen; a click, a new window or a
+		 * window going away is also handled once the layout is back,
+		 * as laying it out would tile the fullscreen one. */
+		if (ev->type == KeyPress || ev->type == ButtonPress || ev->type == MapRequest
+				|| ev->type == DestroyNotify)
+			leave_fullscreen(wm);
+		if (ev->type == KeyPress)
+			return;
+		break;
+	}
+
 	switch (ev->type) {
 	case MapRequest:
 		map_requested(wm, ev);
@@ -955,6 +3532,7 @@ void handle_event(Wm *wm, XEvent *ev)
 		break;
 	case ConfigureRequest:
 		config_request(wm, ev);
+		break;
 	case Expose:
 		expose(wm, ev);
 		break;
@@ -964,17 +3542,608 @@ void handle_event(Wm *wm, XEvent *ev)
 	case KeyPress:
 		key_press(wm, ev);
 		break;
+#ifdef TESTS
+	case ClientMessage:
+		if (ev->xclient.message_type == wm->test)
+			test_message(wm, ev);
+		break;
+#endif
+	}
+}
+
+void dispatch(Wm *wm, XEvent *ev)
+{
+	long start = record_time();
+
+	handle_event(wm, ev);
+	record(RecEvent, ev->type, 0, ev->xany.window, start);
+}
+
+void run_deferred(Wm *wm)
+{
+	unsigned int i;
+
+	wm->timers[TimerDeferred] = 0;
+	for (i = 0; i < wm->n_deferred; i++)
+		dispatch(wm, &wm->deferred[i]);
+	wm->n_deferred = 0;
+}
+
+/* Holds a PropertyNotify or Expose back, replacing the one held for the
+ * same window and property, or growing the area of the one held for the
+ * same window. They only change what's drawn, so input and changes to
+ * the windows are handled before them. They are still handled within
+ * DEFER_DELAY milliseconds however busy the queue is. */
+short int defer(Wm *wm, XEvent *ev)
+{
+	XEvent *d;
+	int x2, y2;
+	unsigned int i;
+
+	if (ev->type != PropertyNotify && ev->type != Expose)
+		return 0;
+
+	for (i = 0; i < wm->n_deferred; i++) {
+		d = &wm->deferred[i];
+		if (d->type != ev->type || d->xany.window != ev->xany.window)
+			continue;
+		if (ev->type == PropertyNotify && d->xproperty.atom == ev->xproperty.atom) {
+			*d = *ev;
+			return 1;
+		}
+		if (ev->type == Expose) {
+			x2 = d->xexpose.x + d->xexpose.width;
+			y2 = d->xexpose.y + d->xexpose.height;
+			if (ev->xexpose.x + ev->xexpose.width > x2)
+				x2 = ev->xexpose.x + ev->xexpose.width;
+			if (ev->xexpose.y + ev->xexpose.height > y2)
+				y2 = ev->xexpose.y + ev->xexpose.height;
+			if (ev->xexpose.x < d->xexpose.x)
+				d->xexpose.x = ev->xexpose.x;
+			if (ev->xexpose.y < d->xexpose.y)
+				d->xexpose.y = ev->xexpose.y;
+			d->xexpose.width = x2 - d->xexpose.x;
+			d->xexpose.height = y2 - d->xexpose.y;
+			d->xexpose.count = 0;
+			return 1;
+		}
+	}
+
+	if (wm->n_deferred == MAX_DEFERRED)
+		run_deferred(wm);
+	wm->deferred[wm->n_deferred] = *ev;
+	if (ev->type == Expose)
+		wm->deferred[wm->n_deferred].xexpose.count = 0;
+	wm->n_deferred++;
+	set_timer(wm, TimerDeferred, DEFER_DELAY);
+	return 1;
+}
+
+static void (*timer_fns[TimerLast])(Wm *wm) = {
+	[TimerFreeze] = freeze_timer,
+	[TimerSwitch] = commit_switch,
+	[TimerUsage] = usage_timer,
+	[TimerLayout] = arrange,
+	[TimerDeferred] = run_deferred,
+	[TimerModules] = modules_timer,
+};
+
+/* Runs the expired timers and returns how long to wait for the next one,
+ * or -1 if none is armed. */
+int run_timers(Wm *wm)
+{
+	int i;
+	long now = now_ms();
+	long next = -1;
+	long start;
+#ifdef TESTS
+	unsigned int seq;
+	unsigned long t;
+#endif
+
+	for (i = 0; i < TimerLast; i++) {
+		if (wm->timers[i] != 0 && wm->timers[i] <= now) {
+			wm->timers[i] = 0;
+			start = record_time();
+#ifdef TESTS
+			if (i == TimerModules || i == TimerUsage) {
+				seq = test_now(wm);
+				t = trips;
+			}
+#endif
+			timer_fns[i](wm);
+#ifdef TESTS
+			if (i == TimerModules || i == TimerUsage)
+				test_leave_out(wm, seq, t);
+#endif
+			record(RecTimer, i, 0, 0, start);
+		}
+	}
+
+	now = now_ms();
+	for (i = 0; i < TimerLast; i++) {
+		if (wm->timers[i] != 0 && (next < 0 || wm->timers[i] - now < next))
+			next = wm->timers[i] > now ? wm->timers[i] - now : 0;
+	}
+
+	return next;
+}
+
+/* Opens the main font, with the ones of config.h after it for the
+ * characters it lacks. The fonts in use are kept if none opens. */
+short int open_fonts(Wm *wm)
+{
+	XftFont *open[MAX_FONTS];
+	int i, n = 0;
+
+	if ((open[n] = XftFontOpenName(wm->dpy, wm->screen, wm->conf.font)) != NULL)
+		n++;
+	for (i = 0; i < LENGTH(fonts) && n < MAX_FONTS; i++) {
+		if (strcmp(fonts[i], wm->conf.font) && (open[n] = XftFontOpenName(wm->dpy, wm->screen, fonts[i])) != NULL)
+			n++;
+	}
+	if (n == 0)
+		return 0;
+
+	for (i = 0; i < wm->n_fonts; i++)
+		XftFontClose(wm->dpy, wm->fonts[i]);
+	memcpy(wm->fonts, open, sizeof(XftFont*) * n);
+	wm->n_fonts = n;
+	wm->xftfont = wm->fonts[0];
+	for (i = 0; i < GLYPH_CACHE; i++)
+		wm->glyphs[i].font = -1;
+	return 1;
+}
+
+/* Sizes the bar for the main font. */
+void bar_metrics(Wm *wm)
+{
+	XGlyphInfo extents;
+
+	XftTextExtentsUtf8(wm->dpy, wm->xftfont, (unsigned char*) "abcdefghijklmnopqrstuvwxyzABCDEFJHIJKLMNOPQRSTUVWXYZ", 52, &extents);
+	wm->bar_height = extents.height + wm->conf.bar_padding * 2;
+	wm->bar_y = extents.y + wm->conf.bar_padding;
+}
+
+void bar_colors(Wm *wm)
+{
+	wm->xrcolor.red = (wm->conf.bar_foreground & 0xff0000) >> 16;
+	wm->xrcolor.green = (wm->conf.bar_foreground & 0x00ff00) >> 8;
+	wm->xrcolor.blue = wm->conf.bar_foreground & 0x0000ff;
+	wm->xrcolor.alpha = 0xffff;
+	XftColorAllocValue(wm->dpy, DefaultVisual(wm->dpy, 0), DefaultColormap(wm->dpy, 0), &wm->xrcolor, &wm->xftcolor);
+	XSetForeground(wm->dpy, wm->bar_gc, wm->conf.bar_background);
+	XSetWindowBackground(wm->dpy, wm->bar, wm->conf.bar_background);
+	XSetWindowBackground(wm->dpy, wm->cli_win, wm->conf.bar_background);
+}
+
+/* Reads the config file over the settings of config.h. Each line has a
+ * setting and its value, and lines starting with # are ignored. Items in
+ * the file replace the ones of config.h. */
+void load_config(Wm *wm, Config *conf)
+{
+	struct stat st;
+	MenuItem *it;
+	char *line, *next, *key, *val, *end, *pool, *word;
+	unsigned int n_args = 0;
+	ssize_t len = -1;
+	int fd;
+
+	conf->font = fonts[0];
+	conf->border_width = BORDER_WIDTH;
+	conf->bar_padding = BAR_PADDING;
+	conf->menu_padding = MENU_PADDING;
+	conf->border_color = BORDER_COLOR;
+	conf->border_focus = BORDER_FOCUS;
+	conf->bar_background = BAR_BACKGROUND;
+	conf->bar_foreground = BAR_FOREGROUND;
+	conf->items = NULL;
+	conf->n_items = 0;
+	conf->text = NULL;
+	conf->args = NULL;
+
+	if (wm->conf_path != NULL && (fd = open(wm->conf_path, O_RDONLY | O_CLOEXEC)) >= 0) {
+		if (fstat(fd, &st) == 0) {
+			conf->text = malloc(st.st_size + 1);
+			assert(conf->text != NULL && "Buy more ram lol");
+			len = read(fd, conf->text, st.st_size);
+		}
+		close(fd);
+	}
+
+	if (len >= 0) {
+		conf->text[len] = '\0';
+		/* More than enough for every line being an item, and every
+		 * other byte being a word of a command. */
+		conf->items = malloc(sizeof(MenuItem) * (len / 2 + 1));
+		conf->args = malloc(sizeof(char*) * (len + 2));
+		assert(conf->items != NULL && conf->args != NULL && "Buy more ram lol");
+
+		for (line = conf->text; line != NULL; line = next) {
+			if ((next = strchr(line, '\n')) != NULL)
+				*next++ = '\0';
+			key = line + strspn(line, " \t");
+			if (*key == '#' || *key == '\0')
+				continue;
+			val = key + strcspn(key, " \t");
+			if (*val != '\0')
+				*val++ = '\0';
+			val += strspn(val, " \t");
+			for (end = val + strlen(val); end > val && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r'); end--);
+			*end = '\0';
+
+			if (!strcmp(key, "font") && *val != '\0') {
+				conf->font = val;
+			} else if (!strcmp(key, "border_width")) {
+				conf->border_width = atoi(val);
+			} else if (!strcmp(key, "bar_padding")) {
+				conf->bar_padding = atoi(val);
+			} else if (!strcmp(key, "menu_padding")) {
+				conf->menu_padding = atoi(val);
+			} else if (!strcmp(key, "border_color")) {
+				conf->border_color = strtoul(val + (*val == '#'), NULL, 16);
+			} else if (!strcmp(key, "border_focus")) {
+				conf->border_focus = strtoul(val + (*val == '#'), NULL, 16);
+			} else if (!strcmp(key, "bar_background")) {
+				conf->bar_background = strtoul(val + (*val == '#'), NULL, 16);
+			} else if (!strcmp(key, "bar_foreground")) {
+				conf->bar_foreground = strtoul(val + (*val == '#'), NULL, 16);
+			} else if (!strcmp(key, "item")) {
+				/* item label pool command arguments... */
+				it = &conf->items[conf->n_items];
+				it->label = strtok(val, " \t");
+				pool = strtok(NULL, " \t");
+				it->command = &conf->args[n_args];
+				while ((word = strtok(NULL, " \t")) != NULL)
+					conf->args[n_args++] = word;
+				conf->args[n_args++] = NULL;
+				if (it->label == NULL || pool == NULL)
+					continue;
+				/* With no command it opens the launcher. */
+				if (it->command[0] == NULL)
+					it->command = NULL;
+				it->size = strlen(it->label);
+				it->pool = atoi(pool);
+				it->x = 0;
+				it->w = 0;
+				conf->n_items++;
+			}
+		}
+	}
+
+	if (conf->n_items == 0) {
+		free(conf->items);
+		conf->items = malloc(sizeof(items));
+		assert(conf->items != NULL && "Buy more ram lol");
+		memcpy(conf->items, items, sizeof(items));
+		conf->n_items = LENGTH(items);
+	}
+}
+
+short int items_differ(Config *a, Config *b)
+{
+	unsigned int i, j;
+
+	if (a->n_items != b->n_items)
+		return 1;
+	for (i = 0; i < a->n_items; i++) {
+		if (strcmp(a->items[i].label, b->items[i].label) || a->items[i].pool != b->items[i].pool)
+			return 1;
+		if (a->items[i].command == NULL || b->items[i].command == NULL) {
+			if (a->items[i].command != b->items[i].command)
+				return 1;
+			continue;
+		}
+		for (j = 0; a->items[i].command[j] != NULL && b->items[i].command[j] != NULL; j++) {
+			if (strcmp(a->items[i].command[j], b->items[i].command[j]))
+				return 1;
+		}
+		if (a->items[i].command[j] != b->items[i].command[j])
+			return 1;
+	}
+	return 0;
+}
+
+MenuItem *pool_item(Wm *wm, MenuItem *old)
+{
+	unsigned int i;
+
+	for (i = 0; i < wm->conf.n_items; i++) {
+		if (!strcmp(wm->conf.items[i].label, old->label))
+			return &wm->conf.items[i];
+	}
+	return NULL;
+}
+
+/* Points the parked windows and the programs being started for the pool
+ * at the new items with the same label. Parked windows whose item is gone
+ * are hidden, and programs still starting are managed as any other. */
+void pool_remap(Wm *wm)
+{
+	Client *c, *next;
+	MenuItem *item;
+	unsigned int j;
+
+	for (c = wm->parked; c != NULL; c = next) {
+		next = c->next;
+		if ((item = pool_item(wm, c->pool)) != NULL) {
+			c->pool = item;
+			continue;
+		}
+		unmanage_hidden(wm, c);
+		c->pool = NULL;
+		c->is_float = 0;
+		XUnmapWindow(wm->dpy, c->id);
+		c->prev = NULL;
+		c->next = wm->hidden;
+		if (wm->hidden != NULL)
+			wm->hidden->prev = c;
+		wm->hidden = c;
+		wm->n_hidden++;
+	}
+
+	for (j = 0; j < wm->n_pending;) {
+		if ((wm->pool_pending[j].item = pool_item(wm, wm->pool_pending[j].item)) == NULL)
+			wm->pool_pending[j] = wm->pool_pending[--wm->n_pending];
+		else
+			j++;
+	}
+}
+
+/* Reads the config file again and applies only what changed. Windows are
+ * kept as they are, only their borders or the layout may change. */
+void reload_config(Wm *wm)
+{
+	Config old = wm->conf;
+	short int font, metrics, bar, borders, buttons, items;
+	unsigned int i, bar_height = wm->bar_height;
+	Client *c;
+	Title *t;
+
+	load_config(wm, &wm->conf);
+	font = strcmp(wm->conf.font, old.font) != 0;
+	metrics = font || wm->conf.bar_padding != old.bar_padding;
+	bar = wm->conf.bar_background != old.bar_background || wm->conf.bar_foreground != old.bar_foreground;
+	borders = wm->conf.border_width != old.border_width
+		|| wm->conf.border_color != old.border_color
+		|| wm->conf.border_focus != old.border_focus;
+	items = items_differ(&wm->conf, &old);
+	buttons = metrics || bar || items || wm->conf.menu_padding != old.menu_padding;
+
+	if (buttons || borders)
+		leave_mode(wm);
+
+	pool_remap(wm);
+
+	/* Only a new font needs them opened again. */
+	if (font && open_fonts(wm)) {
+		/* Every text is measured again with the new fonts. */
+		for (i = 0; i < TITLE_BUCKETS; i++) {
+			for (t = wm->titles[i]; t != NULL; t = t->next)
+				shape(wm, t);
+		}
+	}
+
+	if (metrics) {
+		bar_metrics(wm);
+		if (wm->bar_height != bar_height) {
+			XResizeWindow(wm->dpy, wm->bar, wm->sw, wm->bar_height);
+			XFreePixmap(wm->dpy, wm->bar_buf);
+			wm->bar_buf = XCreatePixmap(wm->dpy, wm->bar, wm->sw, wm->bar_height, DefaultDepth(wm->dpy, wm->screen));
+			XftDrawChange(wm->bar_draw, wm->bar_buf);
+		}
+	}
+
+	if (bar) {
+		XftColorFree(wm->dpy, DefaultVisual(wm->dpy, 0), DefaultColormap(wm->dpy, 0), &wm->xftcolor);
+		bar_colors(wm);
 	}
+
+	if (buttons)
+		render_buttons(wm);
+
+	if (wm->conf.border_width != old.border_width) {
+		for (i = 0; i < wm->n_works; i++) {
+			for (c = wm->works[i]->clients; c != NULL; c = c->next)
+				XSetWindowBorderWidth(wm->dpy, c->id, wm->conf.border_width);
+			for (c = wm->works[i]->floats; c != NULL; c = c->next)
+				XSetWindowBorderWidth(wm->dpy, c->id, wm->conf.border_width);
+		}
+		for (c = wm->hidden; c != NULL; c = c->next)
+			XSetWindowBorderWidth(wm->dpy, c->id, wm->conf.border_width);
+		for (c = wm->parked; c != NULL; c = c->next)
+			XSetWindowBorderWidth(wm->dpy, c->id, wm->conf.border_width);
+	}
+
+	/* The layout also draws the bar. */
+	if (borders || wm->bar_height != bar_height) {
+		place_handle(wm, -1);
+		update_view(wm);
+	} else if (buttons) {
+		render_bar(wm);
+	}
+
+	if (items)
+		pool_fill(wm);
+
+	free(old.items);
+	free(old.args);
+	free(old.text);
+}
+
+/* Watches the config directory or, if it doesn't exist yet, the closest
+ * directory above it that does, to know when the next one is made. */
+void watch_config_dir(Wm *wm)
+{
+	int len = wm->conf_dir_len;
+	char c;
+
+	if (wm->conf_wd >= 0)
+		inotify_rm_watch(wm->inotify, wm->conf_wd);
+	for (;;) {
+		c = wm->conf_path[len];
+		wm->conf_path[len] = '\0';
+		wm->conf_wd = inotify_add_watch(wm->inotify, wm->conf_path, len == wm->conf_dir_len
+			? IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_MOVE_SELF
+			: IN_CREATE | IN_MOVED_TO | IN_MOVE_SELF | IN_ONLYDIR);
+		wm->conf_path[len] = c;
+		if (wm->conf_wd >= 0 || len <= 1)
+			break;
+		for (len--; len > 1 && wm->conf_path[len] != '/'; len--);
+	}
+	wm->conf_watch_len = len;
+}
+
+/* Finds the config file, $XDG_CONFIG_HOME/tibaji/config or
+ * ~/.config/tibaji/config, and watches its directory. */
+void watch_config(Wm *wm)
+{
+	const char *dir = getenv("XDG_CONFIG_HOME");
+	const char *sub = "/tibaji/config";
+	char *slash;
+
+	wm->conf_path = NULL;
+	wm->conf_wd = -1;
+	if (dir == NULL || *dir == '\0') {
+		if ((dir = getenv("HOME")) == NULL)
+			return;
+		sub = "/.config/tibaji/config";
+	}
+
+	wm->conf_path = malloc(strlen(dir) + strlen(sub) + 1);
+	assert(wm->conf_path != NULL && "Buy more ram lol");
+	strcpy(wm->conf_path, dir);
+	strcat(wm->conf_path, sub);
+	slash = strrchr(wm->conf_path, '/');
+	wm->conf_name = slash + 1;
+	wm->conf_dir_len = slash - wm->conf_path;
+
+	if (wm->inotify >= 0)
+		watch_config_dir(wm);
+}
+
+/* Handles the changes in the watched directories. */
+void read_watches(Wm *wm)
+{
+	char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	struct inotify_event *ev;
+	short int reload = 0, progs = 0;
+	unsigned int i;
+	ssize_t n;
+	char *p;
+
+	while ((n = read(wm->inotify, buf, sizeof(buf))) > 0) {
+		for (p = buf; p < buf + n; p += sizeof(struct inotify_event) + ev->len) {
+			ev = (struct inotify_event*) p;
+			/* Changes were lost, so everything is read again. */
+			if (ev->mask & IN_Q_OVERFLOW) {
+				reload = 1;
+				if (wm->conf_path != NULL)
+					watch_config_dir(wm);
+				if (wm->progs_built)
+					fill_progs(wm);
+				progs = 1;
+				continue;
+			}
+			if (ev->wd == wm->conf_wd) {
+				/* A directory on the way to the config file was
+				 * made, or the watched one was moved or removed. The
+				 * file may be there already. */
+				if (wm->conf_watch_len != wm->conf_dir_len || ev->mask & (IN_MOVE_SELF | IN_IGNORED)) {
+					if (ev->mask & IN_IGNORED)
+						wm->conf_wd = -1;
+					watch_config_dir(wm);
+					reload = 1;
+				} else if (ev->len > 0 && !strcmp(ev->name, wm->conf_name)) {
+					reload = 1;
+				}
+			}
+			for (i = 0; i < wm->n_path; i++) {
+				if (ev->wd == wm->path_wds[i] && ev->len > 0) {
+					update_prog(wm, ev->name);
+					progs = 1;
+					break;
+				}
+			}
+		}
+	}
+
+	if (progs && wm->mode == ModeLauncher) {
+		match_progs(wm, 0);
+		draw_launcher(wm);
+	}
+	if (reload)
+		reload_config(wm);
 }
 
 void main_loop(Wm *wm)
 {
 	XEvent ev;
+	struct pollfd pfd[2 + MAX_MODULES];
+	int mod[MAX_MODULES];
+	int timeout, n, i;
+#ifdef TESTS
+	unsigned int seq;
+	unsigned long t;
+#endif
+
+	pfd[0].fd = ConnectionNumber(wm->dpy);
+	pfd[0].events = POLLIN;
+	pfd[1].fd = wm->inotify;
+	pfd[1].events = POLLIN;
 
 	for (;;) {
-		XSync(wm->dpy, False);
-		XNextEvent(wm->dpy, &ev);
-		handle_event(wm, &ev);
+		timeout = run_timers(wm);
+		/* XPending() flushes the requests made so far, and reads what
+		 * the connection has. */
+		if (XPending(wm->dpy)) {
+			XNextEvent(wm->dpy, &ev);
+			if (!defer(wm, &ev))
+				dispatch(wm, &ev);
+			continue;
+		}
+		if (wm->n_deferred > 0) {
+			run_deferred(wm);
+			continue;
+		}
+		/* Replies that were read with the events are handled without
+		 * waiting. Looking for the first one missing reads from the
+		 * connection, which may also take events poll() won't see, but
+		 * that reply hasn't been read yet, so poll() wakes up when it
+		 * comes and they are handled then. */
+		if (poll_replies(wm))
+			continue;
+		if (wm->pending != NULL)
+			xcb_flush(wm->xcb);
+#ifdef TESTS
+		test_answer(wm);
+#endif
+
+		/* Modules open their watch files on their first run, and close
+		 * them if they go away. */
+		for (n = 0, i = 0; i < wm->n_mods; i++) {
+			if (wm->mods[i].watch >= 0) {
+				pfd[2 + n].fd = wm->mods[i].watch;
+				pfd[2 + n].events = POLLIN;
+				mod[n++] = i;
+			}
+		}
+		if (poll(pfd, 2 + n, timeout) <= 0)
+			continue;
+		if (pfd[1].revents & POLLIN)
+			read_watches(wm);
+		for (i = 0; i < n; i++) {
+			if (pfd[2 + i].revents) {
+#ifdef TESTS
+				seq = test_now(wm);
+				t = trips;
+#endif
+				run_module(wm, mod[i]);
+#ifdef TESTS
+				test_leave_out(wm, seq, t);
+#endif
+			}
+		}
 	}
 }
 
@@ -982,19 +4151,10 @@ void scan(Wm *wm)
 {
 	unsigned int j, num;
 	Window d1, d2, *wins = NULL;
-	XWindowAttributes wa;
 
 	if (XQueryTree(wm->dpy, wm->root, &d1, &d2, &wins, &num)) {
-		for (j = 0; j < num; j++) {
-			if (!XGetWindowAttributes(wm->dpy, wins[j], &wa))
-				continue;
-			if (wa.override_redirect || wa.map_state != IsViewable)
-				continue;
-			if (wins[j] == wm->bar || wins[j] == wm->cli_win)
-				continue;
-			if (!managed(wm, wins[j]))
-				manage(wm, wins[j]);
-		}
+		for (j = 0; j < num; j++)
+			request_window(wm, wins[j], 1);
 		if (wins)
 			XFree(wins);
 	}
@@ -1003,10 +4163,17 @@ void scan(Wm *wm)
 int main(void)
 {
 	Wm wm;
-	XGlyphInfo extents;
+	XSetWindowAttributes wa;
+	struct sigaction sa;
+	int i;
 
+	setlocale(LC_CTYPE, "");
 	if (!(wm.dpy = XOpenDisplay(NULL)))
 		return 1;
+	wm.xcb = XGetXCBConnection(wm.dpy);
+	wm.pending = NULL;
+	wm.pending_tail = &wm.pending;
+	wm.n_deferred = 0;
 
 	wm.xftfont = NULL;
 
@@ -1014,30 +4181,30 @@ int main(void)
 	wm.sw = DisplayWidth(wm.dpy, wm.screen);
 	wm.sh = DisplayHeight(wm.dpy, wm.screen);
 	wm.root = RootWindow(wm.dpy, wm.screen);
-	wm.xftfont = XftFontOpenName(wm.dpy, 0, font);
-	if (!wm.xftfont)
+	wm.inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	watch_config(&wm);
+	wm.progs = NULL;
+	wm.n_progs = 0;
+	wm.progs_size = 0;
+	wm.progs_built = 0;
+	wm.n_path = 0;
+	load_config(&wm, &wm.conf);
+	wm.n_fonts = 0;
+	if (!open_fonts(&wm))
 		return 1;
-	wm.xrcolor.red = (BAR_FOREGROUND & 0xff0000) >> 16;
-	wm.xrcolor.green = (BAR_FOREGROUND & 0x00ff00) >> 8;
-	wm.xrcolor.blue = BAR_FOREGROUND & 0x0000ff;
-	wm.xrcolor.alpha = 0xffff;
-	XftColorAllocValue(wm.dpy, DefaultVisual(wm.dpy, 0), DefaultColormap(wm.dpy, 0), &wm.xrcolor, &wm.xftcolor);
 
-	/* Register to get the events. */
+	/* Register to get the events. Pointer motion is only asked for by
+	 * the pointer grabs that need it, so moving the mouse around doesn't
+	 * wake us. */
 	long mask = SubstructureRedirectMask
 		| SubstructureNotifyMask
 		| ButtonPressMask
-		| ButtonReleaseMask
-		| PointerMotionMask
 		| StructureNotifyMask
 		| PropertyChangeMask;
 
 	XSelectInput(wm.dpy, wm.root, mask);
 
-	XftTextExtentsUtf8(wm.dpy, wm.xftfont, (unsigned char*) "abcdefghijklmnopqrstuvwxyzABCDEFJHIJKLMNOPQRSTUVWXYZ", 52, &extents);
-
-	wm.bar_height = extents.height + BAR_PADDING * 2;
-	wm.bar_y = extents.y + BAR_PADDING;
+	bar_metrics(&wm);
 	wm.bar = XCreateSimpleWindow(
 		wm.dpy,
 		wm.root,
@@ -1047,7 +4214,7 @@ int main(void)
 		wm.bar_height,
 		0,
 		0,
-		BAR_BACKGROUND);
+		wm.conf.bar_background);
 	wm.cli_win = XCreateSimpleWindow(
 		wm.dpy,
 		wm.root,
@@ -1057,15 +4224,41 @@ int main(void)
 		10,
 		0,
 		0,
-		BAR_BACKGROUND);
+		wm.conf.bar_background);
+	wm.bar_buf = XCreatePixmap(wm.dpy, wm.bar, wm.sw, wm.bar_height, DefaultDepth(wm.dpy, wm.screen));
+	wm.bar_gc = XCreateGC(wm.dpy, wm.bar_buf, 0, NULL);
+	bar_colors(&wm);
+	wm.bar_draw = XftDrawCreate(wm.dpy, wm.bar_buf, DefaultVisual(wm.dpy, 0), DefaultColormap(wm.dpy, 0));
+	wm.bar_name = NULL;
+	wm.bar_status = NULL;
+	wm.cli_draw = XftDrawCreate(wm.dpy, wm.cli_win, DefaultVisual(wm.dpy, 0), DefaultColormap(wm.dpy, 0));
 	wm.status = NULL;
+	memset(wm.titles, 0, sizeof(wm.titles));
+	wm.free_titles = NULL;
 	XStoreName(wm.dpy, wm.root, "tibaji");
 	XSelectInput(wm.dpy, wm.bar, ExposureMask | ButtonPressMask);
 	XSelectInput(wm.dpy, wm.cli_win, ExposureMask | ButtonPressMask);
+	wm.xim = NULL;
+	wm.xic = NULL;
+	if (XSupportsLocale() && XSetLocaleModifiers("") != NULL)
+		wm.xim = XOpenIM(wm.dpy, NULL, NULL, NULL);
+	if (wm.xim != NULL)
+		wm.xic = XCreateIC(wm.xim,
+			XNInputStyle, XIMPreeditNothing | XIMStatusNothing,
+			XNClientWindow, wm.cli_win,
+			XNFocusWindow, wm.root,
+			NULL);
 	XMapRaised(wm.dpy, wm.bar);
 
 	wm.cursors.left_ptr = XCreateFontCursor(wm.dpy, 68);
 	wm.cursors.sizing = XCreateFontCursor(wm.dpy, 120);
+	wm.cursors.split = XCreateFontCursor(wm.dpy, 108);
+
+	wa.override_redirect = True;
+	wa.cursor = wm.cursors.split;
+	wa.event_mask = ButtonPressMask;
+	wm.handle = XCreateWindow(wm.dpy, wm.root, 0, 0, 1, 1, 0, 0, InputOnly, CopyFromParent, CWOverrideRedirect | CWCursor | CWEventMask, &wa);
+	wm.handle_x = -1;
 
 #ifdef BACKGROUND
 	XSetWindowBackground(wm.dpy, wm.root, BACKGROUND);
@@ -1107,29 +4300,82 @@ int main(void)
 		True,
 		GrabModeAsync,
 		GrabModeAsync);
+	for (i = 0; i < LENGTH(workspace_keys); i++) {
+		XGrabKey(wm.dpy,
+			XKeysymToKeycode(wm.dpy, workspace_keys[i]),
+			MODMASK,
+			wm.root,
+			True,
+			GrabModeAsync,
+			GrabModeAsync);
+	}
 
 	XSetErrorHandler(error_handler);
+	XSetIOErrorHandler(io_error_handler);
 	signal(SIGCHLD, child_handler);
-
-	wm.n_works = 1;
+	sa.sa_handler = dump_handler;
+	sigemptyset(&sa.sa_mask);
+	sa.sa_flags = SA_RESTART;
+	sigaction(SIGUSR1, &sa, NULL);
+	sa.sa_flags = SA_RESETHAND;
+	sigaction(SIGSEGV, &sa, NULL);
+	sigaction(SIGABRT, &sa, NULL);
+	sa.sa_handler = quit_handler;
+	sigaction(SIGTERM, &sa, NULL);
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGHUP, &sa, NULL);
+
+	wm.n_works = 0;
 	wm.n_cur = 0;
+	wm.works_size = 0;
+	wm.works = NULL;
 	wm.n_hidden = 0;
 	wm.hidden = NULL;
-	wm.workspaces = malloc(sizeof(Workspace));
-	assert(wm.workspaces != NULL && "Buy more ram lol");
-	wm.workspaces->n_cli = 0;
-	wm.workspaces->n_float = 0;
-	wm.workspaces->clients = NULL;
-	wm.workspaces->floats = NULL;
-	wm.workspaces->next = NULL;
-	wm.workspaces->prev = NULL;
-	wm.workspaces->current = NULL;
+	wm.parked = NULL;
+	wm.n_pending = 0;
+	wm.net_wm_pid = XInternAtom(wm.dpy, "_NET_WM_PID", False);
+	if (gethostname(wm.host, sizeof(wm.host)) != 0)
+		wm.host[0] = '\0';
+	wm.host[sizeof(wm.host) - 1] = '\0';
+	wm.wm_state = XInternAtom(wm.dpy, "WM_STATE", False);
+#ifdef TESTS
+	wm.test = XInternAtom(wm.dpy, "_TIBAJI_TEST", False);
+#endif
+	build_rules(&wm);
+	memset(wm.timers, 0, sizeof(wm.timers));
+	wm.usage_at = NULL;
+	wm.usages = NULL;
+	wm.usage_list = 0;
+	wm.clock_ticks = sysconf(_SC_CLK_TCK);
+	wm.page_kb = sysconf(_SC_PAGESIZE) / 1024;
+	wm.bar_usage[0] = '\0';
+	wm.n_mods = LENGTH(modules) < MAX_MODULES ? LENGTH(modules) : MAX_MODULES;
+	for (i = 0; i < wm.n_mods; i++) {
+		memset(&wm.mods[i], 0, sizeof(ModuleState));
+		wm.mods[i].fd = -1;
+		wm.mods[i].fd2 = -1;
+		wm.mods[i].watch = -1;
+	}
+	wm.mods_w = 0;
+	wm.mods_dirty = 0;
+	if (wm.n_mods > 0)
+		set_timer(&wm, TimerModules, 0);
+	if (SHOW_USAGE)
+		set_timer(&wm, TimerUsage, USAGE_INTERVAL);
+	new_workspace(&wm);
+	wm.workspaces = wm.works[0];
 
 	wm.wx = wm.sw / 5;
+	wm.switch_to = -1;
+	wm.switched_at = 0;
+	wm.mode = ModeNormal;
+	wm.grabbed = NULL;
 
+	render_buttons(&wm);
 	scan(&wm);
-	update_status(&wm);
+	request_name(&wm, wm.root);
 	render_bar(&wm);
+	pool_fill(&wm);
 	main_loop(&wm);
 
 	return 0;